@@ -0,0 +1,175 @@
+#ifndef DistanceReader_h
+#define DistanceReader_h
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*!
+ * A precomputed symmetric distance matrix of n points, viewed as its condensed upper triangle without the diagonal in
+ * row-major order, i.e. the layout of scipy.spatial.distance.pdist. A binary matrix is mapped into memory as it is,
+ * a CSV matrix is parsed into the same layout.
+ */
+class CondensedMatrix {
+public:
+    CondensedMatrix() : points(0), values(nullptr), mapping(nullptr), mapped_bytes(0) {}
+
+    CondensedMatrix(CondensedMatrix const &) = delete;
+
+    CondensedMatrix &operator=(CondensedMatrix const &) = delete;
+
+    ~CondensedMatrix() {
+        if (mapping != nullptr) {
+            munmap(mapping, mapped_bytes);
+        }
+    }
+
+    /**
+     * @return the number of points
+     */
+    size_t size() const { return points; }
+
+    /**
+     * Gets the distances of point i to all points j > i.
+     * @param i - point i
+     * @return the distances, the one to point j at position j - i - 1
+     */
+    const double *row(size_t i) const {
+        return values + (i * (2 * points - i - 1)) / 2;
+    }
+
+    /**
+     * Gets the distance between two different points.
+     * @param i - point i
+     * @param j - point j
+     * @return the distance between i and j
+     */
+    double at(size_t i, size_t j) const {
+        return i < j ? row(i)[j - i - 1] : row(j)[i - j - 1];
+    }
+
+    /**
+     * Maps a binary condensed matrix, i.e. the n * (n - 1) / 2 distances as doubles in native byte order (e.g. written
+     * by numpy's tofile), into memory without reading it.
+     * @param path - the binary file
+     * @return if the file holds the condensed matrix of at least two points
+     */
+    bool map(std::string const &path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            std::cerr << "Could not read file " << path << std::endl;
+            return false;
+        }
+        auto entries = (size_t) info.st_size / sizeof(double);
+        auto width = (size_t) std::llround((1.0 + std::sqrt(1.0 + 8.0 * (double) entries)) / 2.0);
+        if (entries == 0 || (size_t) info.st_size % sizeof(double) != 0 || width * (width - 1) / 2 != entries) {
+            close(fd);
+            std::cerr << "File " << path << " is no condensed distance matrix of doubles." << std::endl;
+            return false;
+        }
+        void *mapped = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            std::cerr << "Could not map file " << path << std::endl;
+            return false;
+        }
+        mapping = mapped;
+        mapped_bytes = (size_t) info.st_size;
+        points = width;
+        values = static_cast<const double *>(mapped);
+        return true;
+    }
+
+    /**
+     * Parses a dense CSV matrix, i.e. one line of n comma separated distances per point, of which only the upper
+     * triangle is kept. Lines starting with # are skipped like in feature files.
+     * @param path - the CSV file
+     * @return if the file holds a square matrix of at least two points
+     */
+    bool parse(std::string const &path) {
+        std::ifstream input(path);
+        if (!input) {
+            std::cerr << "Could not read file " << path << std::endl;
+            return false;
+        }
+        std::vector<double> upper;
+        size_t width = 0;
+        size_t rows = 0;
+        std::string line;
+        while (std::getline(input, line)) {
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            const char *position = line.c_str();
+            size_t column = 0;
+            while (*position != '\0') {
+                char *end;
+                double value = std::strtod(position, &end);
+                if (end == position) {
+                    break;
+                }
+                if (column > rows && (width == 0 || column < width)) {
+                    upper.push_back(value);
+                }
+                column++;
+                position = *end == ',' ? end + 1 : end;
+            }
+            if (rows == 0) {
+                width = column;
+                if (width < 2) {
+                    break;
+                }
+                // the first row shows the width, so that the whole matrix is allocated once
+                upper.reserve(width * (width - 1) / 2);
+            }
+            if (column != width) {
+                break;
+            }
+            rows++;
+        }
+        if (width < 2 || rows != width) {
+            std::cerr << "File " << path << " is no square distance matrix." << std::endl;
+            return false;
+        }
+        owned = std::move(upper);
+        points = width;
+        values = owned.data();
+        return true;
+    }
+
+private:
+    size_t points;
+    const double *values;
+    /// the parsed distances of a CSV matrix
+    std::vector<double> owned;
+    /// the mapped file of a binary matrix
+    void *mapping;
+    size_t mapped_bytes;
+};
+
+/**
+ * Reads a precomputed distance matrix, which is a dense CSV matrix if the file ends with .csv and a binary condensed
+ * matrix otherwise.
+ * @param path - the file of the matrix
+ * @param matrix - receives the matrix
+ * @return if the matrix could be read
+ */
+inline bool readdistances(std::string const &path, CondensedMatrix &matrix) {
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0) {
+        return matrix.parse(path);
+    }
+    return matrix.map(path);
+}
+
+#endif /* DistanceReader_h */
@@ -145,11 +145,14 @@ int main(int argv, char *args[]) {
     adjust_labels(labels, unique_labels);
     int k = unique_labels.size();
 
+    // Assignment workspace shared by all hamming evaluations
+    AssignmentSolver solver;
+
     // Print out error for each execution tree possible
     exhaustive_distance_learn(
             linkage_type, d0, d1,
             // Handler that prints the error on each parameter interval.
-            [&labels, k, error_type](TreeWithInterval sol) {
+            [&labels, &solver, k, error_type](TreeWithInterval sol) {
                 // Convert the cluster tree into an instance of ClusterNode
                 ClusterNode *cn = sol.tree->convert_to_cluster_node(k, labels);
                 // Calculate the error for the best pruning of this tree
@@ -159,7 +162,7 @@ int main(int argv, char *args[]) {
                         error = prune(*cn, k)[k].cost / labels.size();
                         break;
                     case HAMMING:
-                        error = best_pruning(*cn, k).cost / labels.size();
+                        error = best_pruning(*cn, k, solver).cost / labels.size();
                         break;
                 }
                 // Print result to stdout
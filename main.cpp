@@ -1,7 +1,9 @@
 #include "./utils/AlphaLinkage.h"
 #include "./utils/Evaluation.h"
 #include "./utils/Helpers.h"
+#include "./utils/Isa.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -12,11 +14,37 @@ static void show_usage(std::string name) {
     std::cerr << "Usage: " << name << " <option(s)> SOURCES"
               << "Options:\n"
               << "\t-h,--help\t\tShow this help message\n"
+              << "\t--alpha \t\tCluster at the given alpha only instead of sweeping all values of alpha\n"
+              << "\t--alphagrid \t\tCluster at the centres of the given number of equal cells of alpha instead of sweeping\n"
+              << "\t--alpharange \t\tOnly sweep alpha in the given interval a:b of [0,1], e.g. the job spec of one shard\n"
+              << "\t--checkpoint \t\tCheckpoint every sweep as <file>.checkpoint every given number of seconds\n"
+              << "\t--clusters \t\tSpecify the amount of target clusters of --evaluatetree (default: number of labels)\n"
+              << "\t--coreset \t\tReduce the points to the given number of weighted representatives first (approximate)\n"
+              << "\t--costthreads \t\tSpecify the number of threads that score leaves while the exploration continues\n"
+              << "\t--distances \t\tRead the input files as precomputed distance matrices (.bin condensed or .csv dense) with the labels of the given file\n"
+              << "\t--estimate \t\tOnly estimate the size, runtime and memory of every sweep from the given number of probes\n"
               << "\t-e,--experiment \t\tSpecify the folder path\n"
+              << "\t--focus \t\tOnly explore and report the given candidate intervals of alpha, e.g. 0.1:0.2,0.6:0.7\n"
+              << "\t--evaluatetree \t\tScore the trees of executions given by --input instead of running the linkage\n"
+              << "\t--exporttree \t\tWrite the tree of executions of every input file next to it as <file>.tree\n"
               << "\t-f,--folder \t\tSpecify the folder path\n"
               << "\t-i,--input \t\tSpecify the files path\n"
+              << "\t--isa \t\tOverride the detected instruction set of the scan kernels: sse2, avx2, avx512 or auto\n"
               << "\t-l,--labels \t\tSpecify the specific labels as CSV input, e.g. 0,5,9\n"
+              << "\t--memorylimit \t\tSpill the coldest pending states to --scratchdir above the given number of megabytes\n"
+              << "\t--metric \t\tSpecify the metric of the feature vectors: euclidean (default), sqeuclidean, cosine or manhattan\n"
+              << "\t--mergeshards \t\tStitch the result files of all shards given by --input to one result in --output\n"
+              << "\t--layout \t\tSpecify the distance layout: auto (default), condensed or square\n"
+              << "\t--nobatch \t\tMerge one pair at a time instead of all certified mutual nearest neighbours at once\n"
+              << "\t--nocollapse \t\tKeep identical points as separate clusters instead of one weighted cluster\n"
+              << "\t--parallelsize \t\tSpecify the minimum number of active clusters for which a step uses several threads\n"
+              << "\t--objectives \t\tScore every leaf for each given cost and amount of clusters, e.g. hamming,majority:2-5\n"
               << "\t-p,--points \t\tSpecify how many points of each class are used (will result in num_classes * points_per_class points overall)\n"
+              << "\t--resume \t\tContinue every sweep from its checkpoint if there is one\n"
+              << "\t--scratchdir \t\tSpecify the directory of spilled states (default: /tmp)\n"
+              << "\t--shards \t\tOnly plan the given number of shards with balanced work and write their job specs\n"
+              << "\t--sparse \t\tOnly use the distances to the given number of nearest neighbours of each point (single-complete only)\n"
+              << "\t--threads \t\tSpecify the number of threads used within one state\n"
               << "\t-v,--verbose \t\tShow entire logs"
               << std::endl;
 }
@@ -31,6 +59,69 @@ std::vector<double> split_labels(const std::string &s, char delimiter) {
     return tokens;
 }
 
+/**
+ * Parses a CSV list of intervals a:b, sorts them and joins overlapping ones.
+ * @param s - the list, e.g. 0.1:0.2,0.6:0.7
+ * @param intervals - receives the disjoint intervals in ascending order
+ * @return if all intervals are valid, i.e. 0 <= a < b <= 1
+ */
+bool split_intervals(const std::string &s, std::vector<std::pair<double, double> > &intervals) {
+    std::string token;
+    std::istringstream tokenStream(s);
+    std::vector<std::pair<double, double> > parsed;
+    while (std::getline(tokenStream, token, ',')) {
+        size_t colon = token.find(':');
+        if (colon == std::string::npos) {
+            return false;
+        }
+        parsed.emplace_back(std::stod(token.substr(0, colon)), std::stod(token.substr(colon + 1)));
+        if (parsed.back().first < 0.0 || parsed.back().first >= parsed.back().second || parsed.back().second > 1.0) {
+            return false;
+        }
+    }
+    std::sort(parsed.begin(), parsed.end());
+    intervals.clear();
+    for (auto const &interval : parsed) {
+        if (!intervals.empty() && interval.first <= intervals.back().second) {
+            intervals.back().second = std::max(intervals.back().second, interval.second);
+        } else {
+            intervals.push_back(interval);
+        }
+    }
+    return !intervals.empty();
+}
+
+/**
+ * Parses a CSV list of objectives, i.e. hamming or majority, each optionally followed by :k or a range :a-b of amounts
+ * of target clusters.
+ * @param s - the list, e.g. hamming,majority:2-5
+ * @param objectives - receives the objectives in the given order
+ * @return if all objectives are valid
+ */
+bool split_objectives(const std::string &s, std::vector<Objective> &objectives) {
+    std::string token;
+    std::istringstream tokenStream(s);
+    objectives.clear();
+    while (std::getline(tokenStream, token, ',')) {
+        size_t colon = token.find(':');
+        std::string name = token.substr(0, colon);
+        if (name != "hamming" && name != "majority") {
+            return false;
+        }
+        size_t first = 0, last = 0;
+        if (colon != std::string::npos) {
+            std::string range = token.substr(colon + 1);
+            size_t dash = range.find('-');
+            first = (size_t) std::max(1, std::stoi(range.substr(0, dash)));
+            last = dash == std::string::npos ? first : (size_t) std::max(1, std::stoi(range.substr(dash + 1)));
+        }
+        for (size_t k = first; k <= last; k++) {
+            objectives.emplace_back(name == "majority", k);
+        }
+    }
+    return !objectives.empty();
+}
+
 int main(int argc, char *argv[]) {
     bool average = true;
     bool use_folder = false;
@@ -44,7 +135,11 @@ int main(int argc, char *argv[]) {
     std::vector<std::string> files = {};
     std::vector<double> labels = {};
     bool verbose = false;
+    bool merge_shards = false;
+    bool evaluate_tree = false;
+    size_t clusters = 0;
     double alpha = -1;
+    LinkageOptions options;
 
     // requires at least an input and an input
     if (argc < 3) {
@@ -62,6 +157,53 @@ int main(int argc, char *argv[]) {
             return 0;
         }
 
+        // fixed alpha
+        else if (arg == "--alpha") {
+            if (i + 1 < argc) {
+                i++;
+                alpha = std::stod(argv[i]);
+                if (alpha < 0.0 || alpha > 1.0) {
+                    std::cerr << "--alpha option requires a value in [0,1]." << std::endl;
+                    return 0;
+                }
+            } else {
+                std::cerr << "--alpha option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
+        // grid of fixed alphas
+        else if (arg == "--alphagrid") {
+            if (i + 1 < argc) {
+                i++;
+                options.alpha_grid = (size_t) std::max(1, std::stoi(argv[i]));
+            } else {
+                std::cerr << "--alphagrid option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
+        // interval of alpha
+        else if (arg == "--alpharange") {
+            if (i + 1 < argc) {
+                i++;
+                std::string range = argv[i];
+                size_t colon = range.find(':');
+                if (colon != std::string::npos) {
+                    options.alpha_start = std::stod(range.substr(0, colon));
+                    options.alpha_end = std::stod(range.substr(colon + 1));
+                }
+                if (colon == std::string::npos || options.alpha_start < 0.0 ||
+                    options.alpha_start >= options.alpha_end || options.alpha_end > 1.0) {
+                    std::cerr << "--alpharange option requires an interval a:b with 0 <= a < b <= 1." << std::endl;
+                    return 0;
+                }
+            } else {
+                std::cerr << "--alpharange option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
         // batch id
         else if (arg == "-b" || arg == "--batch") {
             if (i + 1 < argc) {
@@ -73,6 +215,38 @@ int main(int argc, char *argv[]) {
             }
         }
 
+        // amount of target clusters of the evaluated trees
+        else if (arg == "--clusters") {
+            if (i + 1 < argc) {
+                i++;
+                clusters = (size_t) std::max(1, std::stoi(argv[i]));
+            } else {
+                std::cerr << "--clusters option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
+        // precomputed distance matrices
+        else if (arg == "--distances") {
+            if (i + 1 < argc) {
+                i++;
+                options.distance_labels = argv[i];
+            } else {
+                std::cerr << "--distances option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
+        // score trees of executions
+        else if (arg == "--evaluatetree") {
+            evaluate_tree = true;
+        }
+
+        // write trees of executions
+        else if (arg == "--exporttree") {
+            options.export_tree = true;
+        }
+
         // input folder
         else if (arg == "-f" || arg == "--folder") {
             use_folder = true;
@@ -85,6 +259,21 @@ int main(int argc, char *argv[]) {
             }
         }
 
+        // candidate intervals of alpha
+        else if (arg == "--focus") {
+            if (i + 1 < argc) {
+                i++;
+                if (!split_intervals(argv[i], options.focus)) {
+                    std::cerr << "--focus option requires intervals a:b with 0 <= a < b <= 1, e.g. 0.1:0.2,0.6:0.7."
+                              << std::endl;
+                    return 0;
+                }
+            } else {
+                std::cerr << "--focus option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
         // input file
         else if (arg == "-i" || arg == "--input") {
             use_files = true;
@@ -119,11 +308,108 @@ int main(int argc, char *argv[]) {
             }
         }
 
+        // distance layout
+        else if (arg == "--layout") {
+            if (i + 1 < argc) {
+                i++;
+                std::string layout = argv[i];
+                if (layout == "auto") {
+                    options.layout = LAYOUT_AUTO;
+                } else if (layout == "condensed") {
+                    options.layout = LAYOUT_CONDENSED;
+                } else if (layout == "square") {
+                    options.layout = LAYOUT_SQUARE;
+                } else {
+                    std::cerr << "--layout option requires one of auto, condensed or square." << std::endl;
+                    return 0;
+                }
+            } else {
+                std::cerr << "--layout option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
+        // metric of the feature vectors
+        else if (arg == "--metric") {
+            if (i + 1 < argc) {
+                i++;
+                std::string metric = argv[i];
+                if (metric == "euclidean") {
+                    options.metric = METRIC_EUCLIDEAN;
+                } else if (metric == "sqeuclidean") {
+                    options.metric = METRIC_SQEUCLIDEAN;
+                } else if (metric == "cosine") {
+                    options.metric = METRIC_COSINE;
+                } else if (metric == "manhattan") {
+                    options.metric = METRIC_MANHATTAN;
+                } else {
+                    std::cerr << "--metric option requires one of euclidean, sqeuclidean, cosine or manhattan."
+                              << std::endl;
+                    return 0;
+                }
+            } else {
+                std::cerr << "--metric option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
+        // minimum number of active clusters for parallel steps
+        else if (arg == "--parallelsize") {
+            if (i + 1 < argc) {
+                i++;
+                options.parallel_min_active = std::stoul(argv[i]);
+            } else {
+                std::cerr << "--parallelsize option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
+        // memory limit of the pending states
+        else if (arg == "--memorylimit") {
+            if (i + 1 < argc) {
+                i++;
+                options.memory_limit = (size_t) std::max(1, std::stoi(argv[i])) << 20;
+            } else {
+                std::cerr << "--memorylimit option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
+        // stitch the results of shards
+        else if (arg == "--mergeshards") {
+            merge_shards = true;
+        }
+
         // use majority distance
         else if (arg == "-m" || arg == "--majority") {
             use_majority = true;
         }
 
+        // merge one pair at a time
+        else if (arg == "--nobatch") {
+            options.batch_merges = false;
+        }
+
+        // keep identical points apart
+        else if (arg == "--nocollapse") {
+            options.collapse_duplicates = false;
+        }
+
+        // several objectives per leaf
+        else if (arg == "--objectives") {
+            if (i + 1 < argc) {
+                i++;
+                if (!split_objectives(argv[i], options.objectives)) {
+                    std::cerr << "--objectives option requires a list of hamming or majority, each optionally with :k "
+                              << "or :a-b, e.g. hamming,majority:2-5." << std::endl;
+                    return 0;
+                }
+            } else {
+                std::cerr << "--objectives option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
         // skip averaging
         else if (arg == "-n" || arg == "--noaverage") {
             average = false;
@@ -166,23 +452,205 @@ int main(int argc, char *argv[]) {
             mode = "SC";
         }
 
+        // coreset of weighted representatives
+        else if (arg == "--coreset") {
+            if (i + 1 < argc) {
+                i++;
+                options.coreset_size = (size_t) std::max(1, std::stoi(argv[i]));
+            } else {
+                std::cerr << "--coreset option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
+        // periodic checkpoints of a sweep
+        else if (arg == "--checkpoint") {
+            if (i + 1 < argc) {
+                i++;
+                options.checkpoint_interval = (size_t) std::max(1, std::stoi(argv[i]));
+            } else {
+                std::cerr << "--checkpoint option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
+        // continue from the checkpoints
+        else if (arg == "--resume") {
+            options.resume = true;
+        }
+
+        // directory of spilled states
+        else if (arg == "--scratchdir") {
+            if (i + 1 < argc) {
+                i++;
+                options.scratch_dir = argv[i];
+            } else {
+                std::cerr << "--scratchdir option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
+        // instruction set of the kernels
+        else if (arg == "--isa") {
+            if (i + 1 < argc) {
+                i++;
+                if (!Isa::select(argv[i])) {
+                    std::cerr << "--isa must be sse2, avx2, avx512 or auto and supported by the processor (detected: "
+                              << Isa::name(Isa::detect()) << ")." << std::endl;
+                    return 0;
+                }
+            } else {
+                std::cerr << "--isa option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
+        // estimate the size of the tree of executions
+        else if (arg == "--estimate") {
+            if (i + 1 < argc) {
+                i++;
+                options.estimate_probes = (size_t) std::max(1, std::stoi(argv[i]));
+            } else {
+                std::cerr << "--estimate option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
+        // plan shards
+        else if (arg == "--shards") {
+            if (i + 1 < argc) {
+                i++;
+                options.shards = (size_t) std::max(1, std::stoi(argv[i]));
+            } else {
+                std::cerr << "--shards option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
+        // sparse nearest neighbour graph
+        else if (arg == "--sparse") {
+            if (i + 1 < argc) {
+                i++;
+                options.sparse_neighbours = (size_t) std::max(1, std::stoi(argv[i]));
+            } else {
+                std::cerr << "--sparse option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
+        // number of cost workers
+        else if (arg == "--costthreads") {
+            if (i + 1 < argc) {
+                i++;
+                options.cost_threads = (size_t) std::max(0, std::stoi(argv[i]));
+            } else {
+                std::cerr << "--costthreads option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
+        // number of threads per state
+        else if (arg == "--threads") {
+            if (i + 1 < argc) {
+                i++;
+                options.threads = std::max(1, std::stoi(argv[i]));
+            } else {
+                std::cerr << "--threads option requires one argument." << std::endl;
+                return 0;
+            }
+        }
+
         // verbose output
         else if (arg == "-v" || arg == "--verbose") {
             verbose = true;
         }
     }
 
+    // the sparse mode only knows the single and complete linkage updates
+    if (options.sparse_neighbours > 0 && mode != "SC") {
+        std::cerr << "--sparse option requires --singlecomplete." << std::endl;
+        return 0;
+    }
+
+    // the neighbour graph and its bounds only know the euclidean distance
+    if (options.metric != METRIC_EUCLIDEAN && options.sparse_neighbours > 0) {
+        std::cerr << "--sparse option requires the euclidean --metric." << std::endl;
+        return 0;
+    }
+
+    // coresets and the neighbour graph are built from the feature vectors
+    if (!options.distance_labels.empty() && (options.coreset_size > 0 || options.sparse_neighbours > 0)) {
+        std::cerr << "--distances option cannot be combined with --coreset or --sparse." << std::endl;
+        return 0;
+    }
+
+    // a fixed alpha is a grid of one cell that only contains this alpha
+    if (alpha >= 0.0) {
+        options.alpha_start = alpha;
+        options.alpha_end = alpha;
+        options.alpha_grid = 1;
+    }
+
+    // fixed values of alpha need all distances
+    if (options.alpha_grid > 0 && options.sparse_neighbours > 0) {
+        std::cerr << "--alpha and --alphagrid options cannot be combined with --sparse." << std::endl;
+        return 0;
+    }
+
+    // the focus intervals are clipped to the sweep interval, which then shrinks to their hull
+    if (!options.focus.empty()) {
+        std::vector<std::pair<double, double> > clipped;
+        for (auto const &interval : options.focus) {
+            double min = std::max(options.alpha_start, interval.first);
+            double max = std::min(options.alpha_end, interval.second);
+            if (min < max) {
+                clipped.emplace_back(min, max);
+            }
+        }
+        if (clipped.empty()) {
+            std::cerr << "--focus option requires intervals that overlap --alpharange." << std::endl;
+            return 0;
+        }
+        options.focus = clipped;
+        options.alpha_start = options.focus.front().first;
+        options.alpha_end = options.focus.back().second;
+    }
+
+    // stitch the results of shards instead of running
+    if (merge_shards) {
+        if (files.empty() || output.empty()) {
+            std::cerr << "--mergeshards option requires --input files and an --output file." << std::endl;
+            return 0;
+        }
+        Evaluation::merge_shards(files, output);
+        return 0;
+    }
+
+    // score trees of executions instead of running
+    if (evaluate_tree) {
+        if (files.empty()) {
+            std::cerr << "--evaluatetree option requires --input files." << std::endl;
+            return 0;
+        }
+        std::vector<Objective> objectives = options.objectives;
+        if (objectives.empty()) {
+            objectives.emplace_back(use_majority, clusters);
+        }
+        Evaluation::evaluate_trees(files, output, verbose, average && files.size() > 1, objectives, options.threads);
+        return 0;
+    }
+
     // launch experiments for entire directories
     if (use_folder) {
         if (mode == "AC") {
             AlphaLinkage::average_complete_folder(folder, output, labels, points_per_class, batch_id, verbose, average,
-                                                  use_majority);
+                                                  use_majority, options);
         } else if (mode == "SA") {
             AlphaLinkage::single_average_folder(folder, output, labels, points_per_class, batch_id, verbose, average,
-                                                use_majority);
+                                                use_majority, options);
         } else if (mode == "SC") {
             AlphaLinkage::single_complete_folder(folder, output, labels, points_per_class, batch_id, verbose, average,
-                                                 use_majority);
+                                                 use_majority, options);
         }
 
     }
@@ -194,13 +662,13 @@ int main(int argc, char *argv[]) {
         }
         if (mode == "AC") {
             AlphaLinkage::average_complete(files, output, labels, points_per_class, batch_id, verbose, average,
-                                           use_majority);
+                                           use_majority, options);
         } else if (mode == "SA") {
             AlphaLinkage::single_average(files, output, labels, points_per_class, batch_id, verbose, average,
-                                         use_majority);
+                                         use_majority, options);
         } else if (mode == "SC") {
             AlphaLinkage::single_complete(files, output, labels, points_per_class, batch_id, verbose, average,
-                                          use_majority);
+                                          use_majority, options);
         }
     }
     return 0;
@@ -0,0 +1,54 @@
+#ifndef AlignedAllocator_h
+#define AlignedAllocator_h
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+/*!
+ * Minimal allocator that aligns every allocation to Alignment bytes, e.g. to let distance matrix rows start on cache
+ * line boundaries.
+ */
+template<typename T, size_t Alignment>
+class AlignedAllocator {
+public:
+    typedef T value_type;
+
+    template<typename U>
+    struct rebind {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() noexcept {}
+
+    template<typename U>
+    AlignedAllocator(AlignedAllocator<U, Alignment> const &) noexcept {}
+
+    T *allocate(size_t n) {
+        // over-allocate with malloc and keep the original pointer in front of the aligned block, since posix_memalign
+        // fragments the heap badly when large blocks are allocated and released at a high rate
+        void *raw = malloc(n * sizeof(T) + Alignment + sizeof(void *));
+        if (raw == nullptr) {
+            throw std::bad_alloc();
+        }
+        auto address = reinterpret_cast<uintptr_t>(raw) + sizeof(void *);
+        void **aligned = reinterpret_cast<void **>((address + Alignment - 1) & ~(uintptr_t) (Alignment - 1));
+        aligned[-1] = raw;
+        return reinterpret_cast<T *>(aligned);
+    }
+
+    void deallocate(T *ptr, size_t) noexcept {
+        if (ptr != nullptr) {
+            free(reinterpret_cast<void **>(ptr)[-1]);
+        }
+    }
+
+    template<typename U>
+    bool operator==(AlignedAllocator<U, Alignment> const &) const noexcept { return true; }
+
+    template<typename U>
+    bool operator!=(AlignedAllocator<U, Alignment> const &) const noexcept { return false; }
+};
+
+#endif /* AlignedAllocator_h */
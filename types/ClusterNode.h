@@ -1,7 +1,9 @@
 #ifndef ClusterNode_h
 #define ClusterNode_h
 
-#include <vector>
+#include <utility>
+
+#include "LabelCounts.h"
 
 /*!
  * Represents one node in the clustering tree that knows its left and right children and also the counts of now many nodes of each target label are included in its subtree.
@@ -11,13 +13,22 @@ public:
     ClusterNode *left;
     ClusterNode *right;
     bool has_children;
-    std::vector<int> counts;
+    LabelCounts counts;
+
+    ClusterNode(ClusterNode *left, ClusterNode *right, LabelCounts counts, bool has_children) : left(left),
+                                                                                               right(right),
+                                                                                               has_children(
+                                                                                                       has_children),
+                                                                                               counts(std::move(
+                                                                                                       counts)) {}
 
-    ClusterNode(ClusterNode *left, ClusterNode *right, std::vector<int> counts, bool has_children) : left(left),
-                                                                                                     right(right),
-                                                                                                     counts(counts),
-                                                                                                     has_children(
-                                                                                                             has_children) {}
+    /**
+     * Creates the parent node of two merged clusters, whose counts are the sum of the children's counts.
+     * @param left - the first merged cluster
+     * @param right - the second merged cluster
+     */
+    ClusterNode(ClusterNode *left, ClusterNode *right) : left(left), right(right), has_children(true),
+                                                         counts(left->counts + right->counts) {}
 };
 
 #endif /* ClusterNode_hpp */
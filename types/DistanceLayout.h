@@ -0,0 +1,76 @@
+#ifndef DistanceLayout_h
+#define DistanceLayout_h
+
+#include <cstddef>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "InterpolatedDistance.h"
+
+/// pairwise distances as functions of alpha (lower and upper distance) stored interleaved and aligned to cache lines
+typedef std::vector<InterpolatedDistance, AlignedAllocator<InterpolatedDistance, 64> > DistanceFunctions;
+
+/// how the pairwise distances of a state are stored
+enum LayoutMode {
+    LAYOUT_AUTO, LAYOUT_CONDENSED, LAYOUT_SQUARE
+};
+
+/*!
+ * Describes how the pairwise cluster distances are laid out in a flat vector. The condensed layout only stores the
+ * upper triangle without the diagonal (n * (n - 1) / 2 entries). The square layout stores the full symmetric n x n
+ * matrix in row-major order with rows padded to whole cache lines (stride), so that all distances of one cluster lie
+ * contiguously in its row. In both layouts the entries (i, j) with j > i of row i are found at row_base(i) + j.
+ */
+class DistanceLayout {
+public:
+    /// distance entries per 64-byte cache line, rows of the square layout are padded to a multiple of this
+    static const size_t row_alignment = 64 / sizeof(InterpolatedDistance);
+
+    /// number of points, i.e. the width of the full distance matrix
+    size_t width;
+    /// distance between two rows in the square layout, 0 for the condensed layout
+    size_t stride;
+
+    DistanceLayout() : width(0), stride(0) {}
+
+    DistanceLayout(size_t width, size_t stride) : width(width), stride(stride) {}
+
+    static DistanceLayout condensed(size_t width) { return {width, 0}; }
+
+    static DistanceLayout square(size_t width) {
+        return {width, (width + row_alignment - 1) / row_alignment * row_alignment};
+    }
+
+    bool is_square() const { return stride != 0; }
+
+    /**
+     * Calculates the offset such that the distance between clusters i and j > i is stored at row_base(i) + j.
+     * @param i - cluster i
+     * @return the row offset of cluster i
+     */
+    long row_base(long i) const {
+        if (is_square()) {
+            return i * (long) stride;
+        }
+        return (long) ((width * (width - 1)) / 2 - ((width - i) * (width - i - 1)) / 2) - i - 1;
+    }
+
+    /**
+     * Calculates the index of the distance between two different clusters.
+     * @param i - cluster i
+     * @param j - cluster j
+     * @return the index of the distance between i and j
+     */
+    long index(long i, long j) const {
+        return i < j ? row_base(i) + j : row_base(j) + i;
+    }
+
+    /**
+     * @return the number of entries of a distance vector in this layout
+     */
+    size_t entries() const {
+        return is_square() ? width * stride : width * (width - 1) / 2;
+    }
+};
+
+#endif /* DistanceLayout_h */
@@ -0,0 +1,232 @@
+#ifndef ExecutionTree_h
+#define ExecutionTree_h
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ClusterNode.h"
+#include "NodeStore.h"
+#include "SplitState.h"
+
+/// first bytes of every execution tree file, followed by the format version
+const char execution_tree_magic[4] = {'L', 'L', 'E', 'T'};
+const uint32_t execution_tree_version = 1;
+
+/// tags of the records of an execution tree file
+enum ExecutionTreeRecord : uint8_t {
+    RECORD_MERGE = 0, RECORD_SPLIT = 1, RECORD_LEAF = 2
+};
+
+/*!
+ * Writes a tree of executions in a compact binary format while it is explored depth first. The file starts with the
+ * initial clusters, each as the node store of its subtree (e.g. the chain of a group of identical points). Every
+ * state then only adds the merges since its parent: a merge record for each merge of a certified batch, a split record
+ * with the merge of each child when a state splits, and a leaf record with the interval of each leaf. As the children
+ * of a split follow each other in the order of alpha, the merges of every leaf are the merges on its path from the
+ * root. Cluster indices are written as variable length integers, the second one relative to the first.
+ */
+class ExecutionTreeWriter {
+public:
+    ExecutionTreeWriter() {}
+
+    /**
+     * Opens the file and writes the initial clusters.
+     * @param path - the output file
+     * @param clusters - the nodes of all initial clusters in the order of their indices
+     * @return if the file could be opened
+     */
+    bool open(std::string const &path, std::vector<ClusterNode *> const &clusters) {
+        out.open(path, std::ios::binary);
+        if (!out.is_open()) {
+            return false;
+        }
+        out.write(execution_tree_magic, sizeof(execution_tree_magic));
+        out.write(reinterpret_cast<const char *>(&execution_tree_version), sizeof(execution_tree_version));
+        put_varint(clusters.size());
+        for (ClusterNode const *cluster : clusters) {
+            NodeStore::from_tree(*cluster).write(out);
+        }
+        return true;
+    }
+
+    /**
+     * Continues a file that was written up to a checkpoint of the exploration.
+     * @param path - the output file, cut back to its length at the checkpoint
+     * @return if the file could be opened
+     */
+    bool reopen(std::string const &path) {
+        out.open(path, std::ios::binary | std::ios::app);
+        return out.is_open();
+    }
+
+    /**
+     * Writes all records to the file.
+     * @return the length of the file
+     */
+    uint64_t flush() {
+        out.flush();
+        return (uint64_t) out.tellp();
+    }
+
+    bool is_open() const { return out.is_open(); }
+
+    /**
+     * Records a merge of a certified batch of the current state.
+     * @param cluster1 - the kept cluster
+     * @param cluster2 - the merged cluster
+     */
+    void merge(long cluster1, long cluster2) {
+        out.put((char) RECORD_MERGE);
+        put_pair(cluster1, cluster2);
+    }
+
+    /**
+     * Records the split of the current state into one child per split state, the first child becomes the current one.
+     * @param splitstates - the intervals and merges of all children in the order of alpha
+     */
+    void split(std::vector<SplitState> const &splitstates) {
+        out.put((char) RECORD_SPLIT);
+        put_varint(splitstates.size());
+        for (SplitState const &split : splitstates) {
+            put_pair(split.merge_candidate.cluster1, split.merge_candidate.cluster2);
+        }
+    }
+
+    /**
+     * Records that the current state is a leaf, the next child of the nearest unfinished split becomes the current one.
+     * @param alpha_min - start of the leaf's interval
+     * @param alpha_max - end of the leaf's interval
+     */
+    void leaf(double alpha_min, double alpha_max) {
+        out.put((char) RECORD_LEAF);
+        out.write(reinterpret_cast<const char *>(&alpha_min), sizeof(double));
+        out.write(reinterpret_cast<const char *>(&alpha_max), sizeof(double));
+    }
+
+private:
+    std::ofstream out;
+
+    void put_varint(uint64_t value) {
+        while (value >= 0x80) {
+            out.put((char) ((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out.put((char) value);
+    }
+
+    void put_pair(long cluster1, long cluster2) {
+        long delta = cluster2 - cluster1;
+        put_varint((uint64_t) cluster1);
+        put_varint(delta >= 0 ? (uint64_t) delta << 1 : ((uint64_t) -delta << 1) | 1);
+    }
+};
+
+/*!
+ * Reads the leaves of a tree of executions that was written by an ExecutionTreeWriter one after the other, each with
+ * all merges on its path from the root.
+ */
+class ExecutionTreeReader {
+public:
+    /// the subtrees of all initial clusters
+    std::vector<NodeStore> clusters;
+
+    ExecutionTreeReader() {}
+
+    /**
+     * Opens the file and reads the initial clusters.
+     * @param path - the input file
+     * @return if the file is an execution tree file of a known version
+     */
+    bool open(std::string const &path) {
+        in.open(path, std::ios::binary);
+        char magic[sizeof(execution_tree_magic)];
+        uint32_t version = 0;
+        in.read(magic, sizeof(magic));
+        in.read(reinterpret_cast<char *>(&version), sizeof(version));
+        if (!in || std::memcmp(magic, execution_tree_magic, sizeof(magic)) != 0 || version != execution_tree_version) {
+            return false;
+        }
+        clusters.resize(get_varint());
+        for (NodeStore &cluster : clusters) {
+            cluster = NodeStore::read(in);
+        }
+        return (bool) in;
+    }
+
+    /**
+     * Reads the next leaf.
+     * @param alpha_min - receives the start of the leaf's interval
+     * @param alpha_max - receives the end of the leaf's interval
+     * @param merges - receives all merges from the initial clusters to the leaf in their order
+     * @return if there was another leaf
+     */
+    bool next(double &alpha_min, double &alpha_max, std::vector<std::pair<long, long> > &merges) {
+        int tag;
+        while ((tag = in.get()) != std::char_traits<char>::eof()) {
+            if (tag == RECORD_MERGE) {
+                history.push_back(get_pair());
+            } else if (tag == RECORD_SPLIT) {
+                Split split;
+                split.depth = history.size();
+                split.merges.resize(get_varint());
+                for (std::pair<long, long> &merge : split.merges) {
+                    merge = get_pair();
+                }
+                split.next = 1;
+                history.push_back(split.merges[0]);
+                splits.push_back(std::move(split));
+            } else {
+                in.read(reinterpret_cast<char *>(&alpha_min), sizeof(double));
+                in.read(reinterpret_cast<char *>(&alpha_max), sizeof(double));
+                merges = history;
+
+                // continue with the next child of the nearest split that has one left
+                while (!splits.empty() && splits.back().next == splits.back().merges.size()) {
+                    splits.pop_back();
+                }
+                if (!splits.empty()) {
+                    history.resize(splits.back().depth);
+                    history.push_back(splits.back().merges[splits.back().next++]);
+                }
+                return (bool) in;
+            }
+        }
+        return false;
+    }
+
+private:
+    /// a split with unfinished children, whose merges start after depth merges of the history
+    struct Split {
+        size_t depth;
+        std::vector<std::pair<long, long> > merges;
+        size_t next;
+    };
+
+    std::ifstream in;
+    std::vector<std::pair<long, long> > history;
+    std::vector<Split> splits;
+
+    uint64_t get_varint() {
+        uint64_t value = 0;
+        for (int shift = 0; in; shift += 7) {
+            int byte = in.get();
+            value |= (uint64_t) (byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        return value;
+    }
+
+    std::pair<long, long> get_pair() {
+        auto cluster1 = (long) get_varint();
+        uint64_t delta = get_varint();
+        return {cluster1, cluster1 + ((delta & 1) ? -(long) (delta >> 1) : (long) (delta >> 1))};
+    }
+};
+
+#endif /* ExecutionTree_h */
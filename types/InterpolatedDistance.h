@@ -0,0 +1,33 @@
+#ifndef InterpolatedDistance_h
+#define InterpolatedDistance_h
+
+#include "LinearFunction.h"
+
+/*!
+ * Represents the distance of two clusters as function of alpha by its lower (alpha = 0) and upper (alpha = 1) linkage
+ * distance, i.e. (1 - alpha) * lower + alpha * upper. Both ends are kept exactly as the linkage rules compute them,
+ * the slope is only derived where the function is evaluated.
+ */
+class InterpolatedDistance {
+public:
+    double lower;
+    double upper;
+
+    InterpolatedDistance() {};
+
+    InterpolatedDistance(double lower, double upper) : lower(lower), upper(upper) {};
+
+    double at(double alpha) const {
+        return (1 - alpha) * lower + alpha * upper;
+    }
+
+    double slope() const {
+        return upper - lower;
+    }
+
+    LinearFunction function() const {
+        return LinearFunction(upper - lower, lower);
+    }
+};
+
+#endif /* InterpolatedDistance_h */
@@ -0,0 +1,102 @@
+#ifndef LabelCounts_h
+#define LabelCounts_h
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/*!
+ * Stores how many points of each target label are contained in a cluster. Up to inline_capacity labels are kept inline
+ * in a fixed-size array whose unused entries are zero, so that adding two counts is a single fixed-length loop (i.e.
+ * one SIMD add) without any heap allocation. Only instances with more labels fall back to a heap allocated array.
+ */
+class LabelCounts {
+public:
+    /// number of labels that are stored inline, i.e. without heap allocation
+    static const size_t inline_capacity = 16;
+
+    LabelCounts() : size_(0) {
+        inline_.fill(0);
+    }
+
+    explicit LabelCounts(size_t size) : size_(size) {
+        inline_.fill(0);
+        if (size > inline_capacity) {
+            heap_.reset(new int[size]());
+        }
+    }
+
+    LabelCounts(std::vector<int> const &counts) : LabelCounts(counts.size()) {
+        for (size_t i = 0; i < counts.size(); i++) {
+            data()[i] = counts[i];
+        }
+    }
+
+    LabelCounts(LabelCounts const &other) : size_(other.size_), inline_(other.inline_) {
+        if (other.heap_) {
+            heap_.reset(new int[size_]);
+            std::copy(other.heap_.get(), other.heap_.get() + size_, heap_.get());
+        }
+    }
+
+    LabelCounts(LabelCounts &&other) noexcept = default;
+
+    LabelCounts &operator=(LabelCounts const &other) {
+        if (this != &other) {
+            LabelCounts copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    LabelCounts &operator=(LabelCounts &&other) noexcept = default;
+
+    size_t size() const { return size_; }
+
+    int *data() { return heap_ ? heap_.get() : inline_.data(); }
+
+    int const *data() const { return heap_ ? heap_.get() : inline_.data(); }
+
+    int *begin() { return data(); }
+
+    int *end() { return data() + size_; }
+
+    int const *begin() const { return data(); }
+
+    int const *end() const { return data() + size_; }
+
+    int &operator[](size_t i) { return data()[i]; }
+
+    int const &operator[](size_t i) const { return data()[i]; }
+
+    /**
+     * Calculates the pairwise sum of two label counts of the same size.
+     * @param a - counts of the first cluster
+     * @param b - counts of the second cluster
+     * @return the counts of the merged cluster
+     */
+    friend LabelCounts operator+(LabelCounts const &a, LabelCounts const &b) {
+        LabelCounts result(a.size_);
+        if (!result.heap_) {
+            // fixed trip count over the zero padded inline arrays, independent of the actual number of labels
+            for (size_t i = 0; i < inline_capacity; i++) {
+                result.inline_[i] = a.inline_[i] + b.inline_[i];
+            }
+        } else {
+            for (size_t i = 0; i < a.size_; i++) {
+                result.heap_[i] = a.heap_[i] + b.heap_[i];
+            }
+        }
+        return result;
+    }
+
+private:
+    size_t size_;
+    std::array<int, inline_capacity> inline_;
+    std::unique_ptr<int[]> heap_;
+};
+
+#endif /* LabelCounts_h */
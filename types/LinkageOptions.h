@@ -0,0 +1,85 @@
+#ifndef LinkageOptions_h
+#define LinkageOptions_h
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "DistanceLayout.h"
+#include "Objective.h"
+
+/// the metric of the initial distances between feature vectors
+enum DistanceMetric {
+    METRIC_EUCLIDEAN, METRIC_SQEUCLIDEAN, METRIC_COSINE, METRIC_MANHATTAN
+};
+
+/*!
+ * Bundles the options of the alpha linkage. The layout, the threads, the cost workers, the memory limit, the
+ * checkpoints and the instruction set only change how the results are computed. All other options change what is
+ * computed: the input and its metric, the approximations (sparse graph, coreset, fixed alphas), the explored interval
+ * (restriction, focus, shards), the scored objectives and batched merges, which report coarser ranges.
+ */
+class LinkageOptions {
+public:
+    /// how the pairwise distances are stored
+    LayoutMode layout;
+    /// the metric of the initial distances between feature vectors
+    DistanceMetric metric;
+    /// number of threads that a single state may use
+    size_t threads;
+    /// states with at least this many active clusters split each step across threads
+    size_t parallel_min_active;
+    /// merge pairs that are certified for a whole interval at once (reducible linkages only)
+    bool batch_merges;
+    /// start identical points as one cluster weighted by their multiplicity
+    bool collapse_duplicates;
+    /// number of nearest neighbours of every point whose distances are known, 0 knows all distances
+    size_t sparse_neighbours;
+    /// number of weighted representatives the points are reduced to before the linkage, 0 keeps all points
+    size_t coreset_size;
+    /// the interval of alpha that is swept
+    double alpha_start;
+    double alpha_end;
+    /// number of alpha intervals a run is split into for separate processes, 0 runs the sweep itself
+    size_t shards;
+    /// number of random probes that estimate the size of the tree of executions instead of sweeping, 0 sweeps
+    size_t estimate_probes;
+    /// disjoint candidate intervals of alpha in ascending order, only branches that overlap them are explored and
+    /// costs are only reported inside them, empty explores the whole interval
+    std::vector<std::pair<double, double> > focus;
+    /// the cost functions and amounts of target clusters every leaf is scored for, one cost column each, empty
+    /// scores the chosen cost for the number of labels
+    std::vector<Objective> objectives;
+    /// number of threads that score the leaves while the exploration continues, 0 scores them on the exploring thread
+    size_t cost_threads;
+    /// bytes the pending states of a sweep may hold before the coldest ones are spilled to disk, 0 has no limit
+    size_t memory_limit;
+    /// directory of the scratch files of spilled states
+    std::string scratch_dir;
+    /// seconds between two checkpoints of a sweep, 0 writes none
+    size_t checkpoint_interval;
+    /// continue every sweep from its checkpoint if there is one
+    bool resume;
+    /// number of equal cells of the interval of alpha that are each clustered at their centre instead of the sweep,
+    /// 0 sweeps
+    size_t alpha_grid;
+    /// write the tree of executions of every input file next to it (as <file>.tree) for later re-evaluation
+    bool export_tree;
+    /// file of the labels of all points if the input files are precomputed distance matrices instead of feature
+    /// files, empty reads feature files
+    std::string distance_labels;
+
+    LinkageOptions() : layout(LAYOUT_AUTO), metric(METRIC_EUCLIDEAN),
+                       threads(std::max(1u, std::thread::hardware_concurrency())), parallel_min_active(1024),
+                       batch_merges(true), collapse_duplicates(true),
+                       sparse_neighbours(0), coreset_size(0), alpha_start(0.0),
+                       alpha_end(1.0), shards(0), estimate_probes(0),
+                       cost_threads(std::thread::hardware_concurrency() / 2),
+                       memory_limit(0), scratch_dir("/tmp"), checkpoint_interval(0), resume(false),
+                       alpha_grid(0), export_tree(false) {}
+};
+
+#endif /* LinkageOptions_h */
@@ -0,0 +1,154 @@
+#ifndef NodeStore_h
+#define NodeStore_h
+
+#include <cstdint>
+#include <deque>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "ClusterNode.h"
+
+/*!
+ * Index based structure-of-arrays representation of a clustering tree. Nodes are stored in pre-order (root at index 0,
+ * every left child directly after its parent), so each subtree occupies a contiguous index range and a reverse sweep
+ * over the indices visits all children before their parents. Children are referenced by 32-bit indices, whether a
+ * node has children is kept in a bitmap and the label counts of all nodes form one contiguous n_nodes x k matrix. The
+ * store is immutable after construction and can therefore be shared between threads and written to disk as is.
+ */
+class NodeStore {
+public:
+    /// number of labels, i.e. the width of the counts matrix
+    size_t k;
+    std::vector<uint32_t> left;
+    std::vector<uint32_t> right;
+    std::vector<uint64_t> children_bits;
+    std::vector<int> counts;
+
+    NodeStore() : k(0) {}
+
+    size_t size() const { return left.size(); }
+
+    bool has_children(uint32_t node) const { return (children_bits[node >> 6] >> (node & 63)) & 1; }
+
+    int const *counts_of(uint32_t node) const { return counts.data() + node * k; }
+
+    /**
+     * Gets the number of leaves (i.e. points) below a node.
+     * @param node - index of the node
+     * @return the sum of the node's label counts
+     */
+    int leaf_count(uint32_t node) const {
+        int sum = 0;
+        int const *row = counts_of(node);
+        for (size_t c = 0; c < k; c++) {
+            sum += row[c];
+        }
+        return sum;
+    }
+
+    /**
+     * Gets the end of the contiguous index range [node, end) occupied by the subtree of a node.
+     * @param node - index of the node
+     * @return one past the last index of the subtree
+     */
+    uint32_t subtree_end(uint32_t node) const { return node + 2 * (uint32_t) leaf_count(node) - 1; }
+
+    /**
+     * Flattens a pointer based clustering tree into a node store.
+     * @param root - the root of the clustering tree
+     * @return the node store holding the tree in pre-order
+     */
+    static NodeStore from_tree(ClusterNode const &root) {
+        NodeStore store;
+        store.k = root.counts.size();
+        struct Pending {
+            ClusterNode const *node;
+            uint32_t parent;
+            bool is_right;
+        };
+        std::vector<Pending> todo(1, Pending{&root, 0, false});
+        while (!todo.empty()) {
+            Pending cur = todo.back();
+            todo.pop_back();
+            auto index = store.append(cur.node->counts.data(), cur.node->has_children);
+            if (index != 0) {
+                (cur.is_right ? store.right : store.left)[cur.parent] = index;
+            }
+            if (cur.node->has_children) {
+                todo.push_back(Pending{cur.node->right, index, true});
+                todo.push_back(Pending{cur.node->left, index, false});
+            }
+        }
+        return store;
+    }
+
+    /**
+     * Rebuilds the pointer based clustering tree of the store. A reverse sweep creates all children before their
+     * parents.
+     * @param pool - receives the nodes of the tree, which stay valid as long as the pool
+     * @return the root of the clustering tree
+     */
+    ClusterNode *to_tree(std::deque<ClusterNode> &pool) const {
+        std::vector<ClusterNode *> nodes(size());
+        for (uint32_t i = (uint32_t) size(); i-- > 0;) {
+            LabelCounts node_counts(k);
+            std::copy(counts_of(i), counts_of(i) + k, node_counts.begin());
+            pool.emplace_back(has_children(i) ? nodes[left[i]] : nullptr, has_children(i) ? nodes[right[i]] : nullptr,
+                              std::move(node_counts), has_children(i));
+            nodes[i] = &pool.back();
+        }
+        return nodes[0];
+    }
+
+    /**
+     * Writes the store in a binary format.
+     * @param out - output stream
+     */
+    void write(std::ostream &out) const {
+        uint64_t header[2] = {(uint64_t) k, (uint64_t) size()};
+        out.write(reinterpret_cast<const char *>(header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(left.data()), left.size() * sizeof(uint32_t));
+        out.write(reinterpret_cast<const char *>(right.data()), right.size() * sizeof(uint32_t));
+        out.write(reinterpret_cast<const char *>(children_bits.data()), children_bits.size() * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char *>(counts.data()), counts.size() * sizeof(int));
+    }
+
+    /**
+     * Reads a store that was written with write.
+     * @param in - input stream
+     * @return the node store
+     */
+    static NodeStore read(std::istream &in) {
+        NodeStore store;
+        uint64_t header[2] = {0, 0};
+        in.read(reinterpret_cast<char *>(header), sizeof(header));
+        store.k = header[0];
+        store.left.resize(header[1]);
+        store.right.resize(header[1]);
+        store.children_bits.resize((header[1] + 63) / 64);
+        store.counts.resize(header[1] * store.k);
+        in.read(reinterpret_cast<char *>(store.left.data()), store.left.size() * sizeof(uint32_t));
+        in.read(reinterpret_cast<char *>(store.right.data()), store.right.size() * sizeof(uint32_t));
+        in.read(reinterpret_cast<char *>(store.children_bits.data()), store.children_bits.size() * sizeof(uint64_t));
+        in.read(reinterpret_cast<char *>(store.counts.data()), store.counts.size() * sizeof(int));
+        return store;
+    }
+
+private:
+    uint32_t append(int const *node_counts, bool node_has_children) {
+        auto index = (uint32_t) size();
+        left.push_back(0);
+        right.push_back(0);
+        if ((index & 63) == 0) {
+            children_bits.push_back(0);
+        }
+        if (node_has_children) {
+            children_bits.back() |= uint64_t(1) << (index & 63);
+        }
+        counts.insert(counts.end(), node_counts, node_counts + k);
+        return index;
+    }
+};
+
+#endif /* NodeStore_h */
@@ -0,0 +1,28 @@
+#ifndef Objective_h
+#define Objective_h
+
+#include <cstddef>
+#include <string>
+
+/*!
+ * A cost function together with the amount of target clusters that the tree of a leaf is pruned into.
+ */
+class Objective {
+public:
+    /// use majority cost instead of hamming cost
+    bool majority;
+    /// amount of target clusters, 0 uses the number of labels
+    size_t k;
+
+    Objective(bool majority, size_t k) : majority(majority), k(k) {}
+
+    /**
+     * Gets the name of the objective as it is given on the command line, e.g. majority:5.
+     * @return the name of the cost function and the amount of target clusters, if any
+     */
+    std::string name() const {
+        return std::string(majority ? "majority" : "hamming") + (k > 0 ? ":" + std::to_string(k) : "");
+    }
+};
+
+#endif /* Objective_h */
@@ -0,0 +1,76 @@
+#ifndef SparseState_h
+#define SparseState_h
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "ClusterNode.h"
+#include "InterpolatedDistance.h"
+
+/*!
+ * Known distance from one cluster to another in a sparse state. The distance is the linkage over those point pairs of
+ * both clusters that are edges of the neighbour graph, known counts these pairs. Once all pairs of both clusters are
+ * known the distance is exact.
+ */
+struct SparseEdge {
+    long cluster;
+    InterpolatedDistance f;
+    long known;
+
+    SparseEdge(long cluster, InterpolatedDistance f, long known) : cluster(cluster), f(f), known(known) {}
+};
+
+/// the known distances of one cluster, ordered by the other cluster
+typedef std::vector<SparseEdge> SparseRow;
+
+/*!
+ * A SparseSC_State is a state for interpolating between single and complete linkage that only knows the distances
+ * along the edges of a k-nearest-neighbour graph, which takes O(n * k) instead of O(n^2) memory. Every cluster keeps
+ * its known distances as an adjacency row. Pairs of clusters without a known distance are never merged as long as
+ * any known distance is left.
+ *
+ * Each cluster also keeps its points and the smallest k-nearest-neighbour radius of them, since two points that are
+ * no edge are at least as far apart as the larger of their radii, and the reach, i.e. the largest distance of its
+ * points to the first one (its anchor). This bounds all unknown distances and lets every merge be checked against the
+ * exact linkage. exact stays true as long as all merges of the state would also have
+ * been made with all distances known.
+ */
+class SparseSC_State {
+public:
+    /// the interpolated linkage stays reducible on the known distances
+    static const bool reducible = true;
+
+    double alpha_min;
+    double alpha_max;
+    std::vector<SparseRow> rows;
+    std::vector<double> row_bounds;
+    std::vector<double> radii;
+    std::vector<double> reach;
+    std::vector<std::vector<long> > members;
+    std::shared_ptr<const std::vector<std::vector<double> > > points;
+    std::vector<long> active_indices;
+    std::vector<ClusterNode *> nodes;
+    /// number of known distances between active clusters
+    long edges;
+    /// number of known distances between active clusters that do not cover all point pairs yet
+    long incomplete;
+    bool exact;
+    /// number of the scratch file that holds the rows while the state is spilled to disk, -1 if they are in memory
+    long spilled;
+
+    SparseSC_State() : alpha_min(0.0), alpha_max(1.0), edges(0), incomplete(0), exact(true), spilled(-1) {};
+
+    SparseSC_State(double amin, double amax, std::vector<SparseRow> r, std::vector<double> rb, std::vector<double> rad,
+                   std::vector<std::vector<long> > m, std::shared_ptr<const std::vector<std::vector<double> > > p,
+                   std::vector<long> ai, std::vector<ClusterNode *> n)
+            : alpha_min(amin), alpha_max(amax), rows(std::move(r)), row_bounds(std::move(rb)), radii(std::move(rad)),
+              reach(radii.size(), 0.0), members(std::move(m)), points(std::move(p)), active_indices(std::move(ai)),
+              nodes(std::move(n)), edges(0), incomplete(0), exact(true), spilled(-1) {};
+
+    bool operator==(const SparseSC_State &s1) {
+        return s1.alpha_min == alpha_min && s1.alpha_max == alpha_max && s1.active_indices == active_indices;
+    }
+};
+
+#endif /* SparseState_h */
@@ -1,25 +1,33 @@
 #ifndef State_h
 #define State_h
 
+#include <utility>
+#include <vector>
+
 #include "ClusterNode.h"
+#include "DistanceLayout.h"
 
 /*!
- * A state represents one possible clustering at any given time of the linkage based agglomerative hierarchical clustering algorithm. Each state is valid for a given range of the parameter alpha and thus represented by a lower boundary alpha_min and an upper boundary alpha_max. For each state, we store the distance matrices for both the lower and the upper distances. This dyamic programming approach improves the performance a lot over calculating the distances over and over again. Each state also contains the active_indices, that indicate which clusters were not merged yet. A vector of node represents the underlying cluster structure of a state.
+ * A state represents one possible clustering at any given time of the linkage based agglomerative hierarchical clustering algorithm. Each state is valid for a given range of the parameter alpha and thus represented by a lower boundary alpha_min and an upper boundary alpha_max. For each state, we store the distance of every pair of clusters as function of alpha, i.e. the lower (alpha = 0) and the upper (alpha = 1) distance, interleaved in one matrix in the state's layout (condensed or square). Next to it, row_bounds holds a lower bound of all distances in each row of the upper triangle within [alpha_min, alpha_max], which lets the scans skip whole rows. This dyamic programming approach improves the performance a lot over calculating the distances over and over again. Each state also contains the active_indices, that indicate which clusters were not merged yet. A vector of node represents the underlying cluster structure of a state.
  */
 class State {
 public:
     double alpha_min;
     double alpha_max;
-    std::vector<double> lower_dists;
-    std::vector<double> upper_dists;
+    DistanceFunctions dists;
+    DistanceLayout layout;
+    std::vector<double> row_bounds;
     std::vector<long> active_indices;
     std::vector<ClusterNode *> nodes;
+    /// number of the scratch file that holds the distances while the state is spilled to disk, -1 if they are in memory
+    long spilled;
 
-    State() {};
+    State() : spilled(-1) {};
 
-    State(double amin, double amax, std::vector<double> mind, std::vector<double> maxd, std::vector<long> ai,
-          std::vector<ClusterNode *> n) : alpha_min(amin), alpha_max(amax), lower_dists(mind), upper_dists(maxd),
-                                          active_indices(ai), nodes(n) {};
+    State(double amin, double amax, DistanceFunctions d, DistanceLayout dl, std::vector<double> rb,
+          std::vector<long> ai, std::vector<ClusterNode *> n)
+            : alpha_min(amin), alpha_max(amax), dists(std::move(d)), layout(dl), row_bounds(std::move(rb)),
+              active_indices(std::move(ai)), nodes(std::move(n)), spilled(-1) {};
 
     bool operator==(const State &s1) {
         return s1.alpha_min == alpha_min && s1.alpha_max == alpha_max && s1.active_indices == active_indices;
@@ -31,10 +39,14 @@ public:
  */
 class SC_State : public State {
 public:
+    /// the interpolated linkage is reducible, i.e. merging never brings a cluster closer than its parts were
+    static const bool reducible = true;
+
     SC_State() {};
 
-    SC_State(double amin, double amax, std::vector<double> mind, std::vector<double> maxd, std::vector<long> ai,
-             std::vector<ClusterNode *> n) : State(amin, amax, mind, maxd, ai, n) {};
+    SC_State(double amin, double amax, DistanceFunctions d, DistanceLayout dl, std::vector<double> rb,
+             std::vector<long> ai, std::vector<ClusterNode *> n)
+            : State(amin, amax, std::move(d), dl, std::move(rb), std::move(ai), std::move(n)) {};
 };
 
 /*!
@@ -42,13 +54,17 @@ public:
  */
 class SA_State : public State {
 public:
-    std::vector<short> cluster_sizes;
+    /// mixing the minimum with the average can bring merged clusters closer than their parts, so it is not reducible
+    static const bool reducible = false;
+
+    std::vector<int> cluster_sizes;
 
     SA_State() {};
 
-    SA_State(double amin, double amax, std::vector<double> mind, std::vector<double> avgd, std::vector<long> ai,
-             std::vector<ClusterNode *> n, std::vector<short> cs) : State(amin, amax, mind, avgd, ai, n),
-                                                                    cluster_sizes(cs) {};
+    SA_State(double amin, double amax, DistanceFunctions d, DistanceLayout dl, std::vector<double> rb,
+             std::vector<long> ai, std::vector<ClusterNode *> n, std::vector<int> cs)
+            : State(amin, amax, std::move(d), dl, std::move(rb), std::move(ai), std::move(n)),
+              cluster_sizes(std::move(cs)) {};
 };
 
 /*!
@@ -56,13 +72,17 @@ public:
  */
 class AC_State : public State {
 public:
-    std::vector<short> cluster_sizes;
+    /// the interpolated linkage is reducible, i.e. merging never brings a cluster closer than its parts were
+    static const bool reducible = true;
+
+    std::vector<int> cluster_sizes;
 
     AC_State() {};
 
-    AC_State(double amin, double amax, std::vector<double> avgd, std::vector<double> maxd, std::vector<long> ai,
-             std::vector<ClusterNode *> n, std::vector<short> cs) : State(amin, amax, avgd, maxd, ai, n),
-                                                                    cluster_sizes(cs) {};
+    AC_State(double amin, double amax, DistanceFunctions d, DistanceLayout dl, std::vector<double> rb,
+             std::vector<long> ai, std::vector<ClusterNode *> n, std::vector<int> cs)
+            : State(amin, amax, std::move(d), dl, std::move(rb), std::move(ai), std::move(n)),
+              cluster_sizes(std::move(cs)) {};
 };
 
 #endif /* State_h */
@@ -1,201 +1,299 @@
 #include "AlphaLinkage.h"
 
 #include "../utils/Clustering.h"
+#include "../utils/SparseLinkage.h"
 
 #include <chrono>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <stack>
 #include <vector>
 
 #include "CSVReader.h"
+#include "DistanceReader.h"
 #include "Helpers.h"
 
 #include "AlphaRange.h"
 #include "State.h"
 
+#include "../utils/Coreset.h"
+#include "../utils/Estimate.h"
 #include "../utils/Evaluation.h"
+#include "../utils/FixedAlpha.h"
 #include "../utils/InitOperations.h"
 
-void AlphaLinkage::single_complete(const std::vector<std::string> &files, const std::string &output_file,
-                                   const std::vector<double> &sublabels, int points_per_label, int batch_id,
-                                   bool verbose, bool average, bool use_majority) {
-    auto start = std::chrono::high_resolution_clock::now();
-    std::vector<AlphaRange> ranges;
-    int file_id = 0;
-    std::vector<double> cur_labels;
-    for (const auto &file : files) {
-        if (Helpers::hasEnding(file, ".csv")) {
-            cur_labels = sublabels;
-            file_id++;
-
-            // read csv file and get labels and feature vectors
-            std::vector<std::vector<double> > data = readcsv(file);
-            std::cout << "Processing " << file << std::endl;
-            std::vector<double> labels;
-            std::vector<std::vector<double> > feature_vectors;
-            Helpers::load_data(data, labels, feature_vectors, sublabels, points_per_label, batch_id);
-            if (cur_labels.empty()) {
-                cur_labels = Helpers::getUniqueValues(labels);
-            }
+namespace {
 
-            // init operations
-            std::vector<SC_State> states;
-            SC_State state;
-            getinitstate(state, feature_vectors, labels, cur_labels);
-            states.push_back(state);
-
-            // calculate all intervals
-            std::vector<AlphaRange> res = Clustering::getranges(states, output_file, labels.size(), cur_labels.size(),
-                                                                verbose, average, use_majority);
-            for (AlphaRange const &r : res) {
-                ranges.push_back(r);
-            }
+    /*!
+     * Estimates the error of the coreset on a uniform sample of the points, i.e. the mean absolute difference between
+     * the landscape of all sampled points and the landscape of a coreset of the sample with the same reduction ratio.
+     */
+    template<typename S>
+    double estimate_coreset_error(const std::vector<std::vector<double> > &feature_vectors,
+                                  const std::vector<double> &labels, const std::vector<double> &cur_labels,
+                                  bool use_majority, const LinkageOptions &options, size_t &sample_size) {
+        std::vector<size_t> sample = Coreset::getsample(labels.size(), Coreset::sample_points);
+        std::vector<std::vector<double> > sample_vectors;
+        std::vector<double> sample_labels;
+        for (size_t p : sample) {
+            sample_vectors.push_back(feature_vectors[p]);
+            sample_labels.push_back(labels[p]);
         }
-    }
+        sample_size = sample.size();
 
-    // average if wanted
-    if (average) {
-        std::vector<AlphaRange> output_costs = Evaluation::average_costs(ranges, file_id);
-        std::sort(output_costs.begin(), output_costs.end(), Helpers::compareByAlphaMin);
-        if (!output_file.empty()) {
-            std::ofstream stream;
-            stream.open(output_file);
-            for (AlphaRange const &range : output_costs) {
-                stream << range.min << "," << range.max << "," << range.cost << "\n";
-            }
-            stream.close();
+        LinkageOptions full = options;
+        full.coreset_size = 0;
+        LinkageOptions reduced = options;
+        reduced.coreset_size = std::max<size_t>(1, (size_t) std::lround(
+                (double) sample.size() * (double) options.coreset_size / (double) labels.size()));
+        std::vector<std::vector<AlphaRange> > landscapes;
+        for (LinkageOptions const &sample_options : {full, reduced}) {
+            std::vector<S> states(1);
+            getinitstate(states[0], sample_vectors, sample_labels, cur_labels, sample_options);
+            landscapes.push_back(Clustering::getranges(states, "", sample_labels.size(), cur_labels.size(), false,
+                                                       true, use_majority, sample_options));
+            std::sort(landscapes.back().begin(), landscapes.back().end(), Helpers::compareByAlphaMin);
         }
+        return Evaluation::landscape_error(landscapes[0], landscapes[1]);
     }
-    auto finish = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> elapsed = finish - start;
-    std::cout << "Finished after " << elapsed.count() << " seconds.\n";
-}
 
-void AlphaLinkage::single_average(const std::vector<std::string> &files, const std::string &output_file,
-                                  const std::vector<double> &sublabels, int points_per_label, int batch_id,
-                                  bool verbose, bool average, bool use_majority) {
-    auto start = std::chrono::high_resolution_clock::now();
-    std::vector<AlphaRange> ranges;
-    std::vector<double> cur_labels;
-    int file_id = 0;
-    for (const auto &file : files) {
-        if (Helpers::hasEnding(file, ".csv")) {
-            cur_labels = sublabels;
-            file_id++;
-            // read csv file and get labels and feature vectors
-            std::vector<std::vector<double> > data = readcsv(file);
-            std::cout << "Processing " << file << std::endl;
-            std::vector<double> labels;
-            std::vector<std::vector<double> > feature_vectors;
-            Helpers::load_data(data, labels, feature_vectors, sublabels, points_per_label, batch_id);
-            if (cur_labels.empty()) {
-                cur_labels = Helpers::getUniqueValues(labels);
+    /*!
+     * Runs the alpha linkage for the state type S (i.e. the interpolated pair of linkages) on all given files and
+     * averages the resulting costs if wanted.
+     */
+    template<typename S>
+    void run(const std::vector<std::string> &files, const std::string &output_file,
+             const std::vector<double> &sublabels, int points_per_label, int batch_id, bool verbose, bool average,
+             bool use_majority, const LinkageOptions &options) {
+        auto start = std::chrono::high_resolution_clock::now();
+        // the ranges of every objective, i.e. one cost column each
+        std::vector<std::vector<AlphaRange> > ranges(std::max<size_t>(1, options.objectives.size()));
+        int file_id = 0;
+        std::vector<double> cur_labels;
+        if (!options.objectives.empty()) {
+            std::cout << "Columns: alpha_min,alpha_max";
+            for (Objective const &objective : options.objectives) {
+                std::cout << "," << objective.name();
             }
+            std::cout << std::endl;
+        }
 
-            // init operations
-            std::vector<SA_State> states;
-            SA_State state;
-            getinitstate(state, feature_vectors, labels, cur_labels);
-            states.push_back(state);
-
-            // calculate all intervals
-            std::vector<AlphaRange> res = Clustering::getranges(states, output_file, labels.size(), cur_labels.size(),
-                                                                verbose, average, use_majority);
-            for (AlphaRange const &r : res) {
-                ranges.push_back(r);
+        // the labels of the points of all precomputed distance matrices, in the rows of a CSV file or one per line
+        std::vector<double> distance_labels;
+        if (!options.distance_labels.empty()) {
+            for (std::vector<double> const &row : readcsv(options.distance_labels)) {
+                distance_labels.insert(distance_labels.end(), row.begin(), row.end());
             }
         }
-    }
+        for (const auto &file : files) {
+            bool matrix_file = !options.distance_labels.empty() && Helpers::hasEnding(file, ".bin");
+            if (Helpers::hasEnding(file, ".csv") || matrix_file) {
+                cur_labels = sublabels;
+                std::vector<double> labels;
+                std::vector<std::vector<double> > feature_vectors;
+                S state;
+                if (options.distance_labels.empty()) {
+                    // read csv file and get labels and feature vectors
+                    std::vector<std::vector<double> > data = readcsv(file);
+                    std::cout << "Processing " << file << std::endl;
+                    Helpers::load_data(data, labels, feature_vectors, sublabels, points_per_label, batch_id);
+                    if (cur_labels.empty()) {
+                        cur_labels = Helpers::getUniqueValues(labels);
+                    }
+
+                    // init operations
+                    getinitstate(state, feature_vectors, labels, cur_labels, options);
+                } else {
+                    // map or parse the precomputed distances, which are used as they are
+                    CondensedMatrix matrix;
+                    if (!readdistances(file, matrix)) {
+                        continue;
+                    }
+                    if (matrix.size() != distance_labels.size()) {
+                        std::cerr << "File " << file << " has distances of " << matrix.size() << " points but "
+                                  << options.distance_labels << " has " << distance_labels.size() << " labels."
+                                  << std::endl;
+                        continue;
+                    }
+                    std::cout << "Processing " << file << std::endl;
+
+                    // select the points like the rows of a feature file whose only feature is the index of the point
+                    std::vector<std::vector<double> > data;
+                    for (size_t p = 0; p < distance_labels.size(); p++) {
+                        data.push_back({distance_labels[p], (double) p});
+                    }
+                    std::vector<std::vector<double> > selected;
+                    Helpers::load_data(data, labels, selected, sublabels, points_per_label, batch_id);
+                    std::vector<size_t> points;
+                    for (std::vector<double> const &point : selected) {
+                        points.push_back((size_t) point[0]);
+                    }
+                    if (cur_labels.empty()) {
+                        cur_labels = Helpers::getUniqueValues(labels);
+                    }
+
+                    // init operations
+                    getinitstate(state, matrix, points, labels, cur_labels, options);
+                }
+                file_id++;
+                std::vector<S> states;
+                size_t clusters = state.active_indices.size();
+                states.push_back(std::move(state));
 
-    // average if wanted
-    if (average) {
-        std::vector<AlphaRange> output_costs = Evaluation::average_costs(ranges, file_id);
-        std::sort(output_costs.begin(), output_costs.end(), Helpers::compareByAlphaMin);
-        if (!output_file.empty()) {
-            std::ofstream stream;
-            stream.open(output_file);
-            for (AlphaRange const &range : output_costs) {
-                stream << range.min << "," << range.max << "," << range.cost << "\n";
+                // only plan the shards of the run, each written as job spec "file alpha_min:alpha_max"
+                if (options.shards > 0) {
+                    std::ofstream specs;
+                    if (!output_file.empty()) {
+                        specs.open(output_file, file_id == 1 ? std::ios::trunc : std::ios::app);
+                    }
+                    for (auto const &shard : Estimate::getshards(states, options.shards, use_majority,
+                                                                 cur_labels.size(), options)) {
+                        std::ostringstream spec;
+                        spec << std::setprecision(17) << file << " " << shard.first << ":" << shard.second;
+                        std::cout << "Shard " << spec.str() << std::endl;
+                        if (specs.is_open()) {
+                            specs << spec.str() << "\n";
+                        }
+                    }
+                    continue;
+                }
+
+                // only estimate the size of the sweep, each written as one JSON object per line
+                if (options.estimate_probes > 0) {
+                    std::ofstream estimates;
+                    if (!output_file.empty()) {
+                        estimates.open(output_file, file_id == 1 ? std::ios::trunc : std::ios::app);
+                    }
+                    std::string json = Estimate::probe(states[0], options.estimate_probes, use_majority,
+                                                       cur_labels.size(), options).json(file);
+                    std::cout << json << std::endl;
+                    if (estimates.is_open()) {
+                        estimates << json << "\n";
+                    }
+                    continue;
+                }
+
+                // calculate all intervals
+                std::vector<std::vector<AlphaRange> > res;
+                if (options.alpha_grid > 0) {
+                    // cluster at fixed values of alpha instead of the sweep
+                    res = FixedAlpha::getgridranges(states[0], output_file, labels.size(), cur_labels.size(), verbose,
+                                                    average, use_majority, options);
+                } else {
+                    // a checkpoint is kept next to the input file like its tree of executions
+                    bool checkpoint = options.checkpoint_interval > 0 || options.resume;
+                    Clustering::getranges(states, output_file, labels.size(), cur_labels.size(), verbose, average,
+                                          use_majority, options, options.export_tree ? file + ".tree" : "",
+                                          checkpoint ? file + ".checkpoint" : "",
+                                          checkpoint ? Checkpoint::input_id(file, sublabels, points_per_label,
+                                                                            batch_id, options.distance_labels) : "",
+                                          &res);
+                }
+                for (size_t o = 0; o < res.size(); o++) {
+                    ranges[o].insert(ranges[o].end(), res[o].begin(), res[o].end());
+                }
+
+                // report the reduction of the coreset and its estimated error
+                if (options.coreset_size > 0 && options.coreset_size < labels.size()) {
+                    size_t sample_size = 0;
+                    double error = estimate_coreset_error<S>(feature_vectors, labels, cur_labels, use_majority,
+                                                             options, sample_size);
+                    std::cout << "Coreset reduced " << labels.size() << " points to " << clusters
+                              << " representatives (ratio " << (double) clusters / (double) labels.size()
+                              << "), estimated landscape error " << error << " on a sample of " << sample_size
+                              << " points" << std::endl;
+                }
             }
-            stream.close();
         }
-    }
-    auto finish = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> elapsed = finish - start;
-    std::cout << "Finished after " << elapsed.count() << " seconds.\n";;
-}
 
-void AlphaLinkage::average_complete(const std::vector<std::string> &files, const std::string &output_file,
-                                    const std::vector<double> &sublabels, int points_per_label, int batch_id,
-                                    bool verbose, bool average, bool use_majority) {
-    auto start = std::chrono::high_resolution_clock::now();
-    std::vector<AlphaRange> ranges;
-    std::vector<double> cur_labels;
-    int file_id = 0;
-    for (const auto &file : files) {
-        if (Helpers::hasEnding(file, ".csv")) {
-            cur_labels = sublabels;
-            file_id++;
-            // read csv file and get labels and feature vectors
-            std::vector<std::vector<double> > data = readcsv(file);
-            std::cout << "Processing " << file << std::endl;
-            std::vector<double> labels;
-            std::vector<std::vector<double> > feature_vectors;
-            Helpers::load_data(data, labels, feature_vectors, sublabels, points_per_label, batch_id);
-            if (sublabels.empty()) {
-                cur_labels = Helpers::getUniqueValues(labels);
+        // average if wanted, all objectives share the same ranges as these only depend on the input intervals
+        if (average && options.shards == 0 && options.estimate_probes == 0) {
+            std::vector<std::vector<AlphaRange> > output_costs;
+            for (std::vector<AlphaRange> const &column : ranges) {
+                if (options.alpha_grid > 0) {
+                    // all files share the same cells, which may be a single value of alpha
+                    output_costs.emplace_back(column.begin(), column.begin() + options.alpha_grid);
+                    for (size_t cell = 0; cell < options.alpha_grid; cell++) {
+                        for (size_t f = 1; f < column.size() / options.alpha_grid; f++) {
+                            output_costs.back()[cell].cost += column[f * options.alpha_grid + cell].cost;
+                        }
+                        output_costs.back()[cell].cost /= (double) file_id;
+                    }
+                    continue;
+                }
+                output_costs.push_back(Evaluation::average_costs(column, file_id, options.alpha_start,
+                                                                 options.alpha_end));
+                std::sort(output_costs.back().begin(), output_costs.back().end(), Helpers::compareByAlphaMin);
             }
-
-            // init operations
-            std::vector<AC_State> states;
-            AC_State state;
-            getinitstate(state, feature_vectors, labels, cur_labels);
-            states.push_back(state);
-
-            // calculate all intervals
-            std::vector<AlphaRange> res = Clustering::getranges(states, output_file, labels.size(), cur_labels.size(),
-                                                                verbose, average, use_majority);
-            for (AlphaRange const &r : res) {
-                ranges.push_back(r);
+            if (!output_file.empty()) {
+                std::ofstream stream;
+                stream.open(output_file);
+                for (size_t i = 0; i < output_costs[0].size(); i++) {
+                    for (AlphaRange const &range : Clustering::focus_ranges(output_costs[0][i], options)) {
+                        stream << range.min << "," << range.max;
+                        for (std::vector<AlphaRange> const &column : output_costs) {
+                            stream << "," << column[i].cost;
+                        }
+                        stream << "\n";
+                    }
+                }
+                stream.close();
             }
         }
+        auto finish = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed = finish - start;
+        std::cout << "Finished after " << elapsed.count() << " seconds.\n";
     }
+}
 
-    // average if wanted
-    if (average) {
-        std::vector<AlphaRange> output_costs = Evaluation::average_costs(ranges, file_id);
-        std::sort(output_costs.begin(), output_costs.end(), Helpers::compareByAlphaMin);
-        if (!output_file.empty()) {
-            std::ofstream stream;
-            stream.open(output_file);
-            for (AlphaRange const &range : output_costs) {
-                stream << range.min << "," << range.max << "," << range.cost << "\n";
-            }
-            stream.close();
-        }
+void AlphaLinkage::single_complete(const std::vector<std::string> &files, const std::string &output_file,
+                                   const std::vector<double> &sublabels, int points_per_label, int batch_id,
+                                   bool verbose, bool average, bool use_majority, const LinkageOptions &options) {
+    if (options.sparse_neighbours > 0) {
+        run<SparseSC_State>(files, output_file, sublabels, points_per_label, batch_id, verbose, average, use_majority,
+                            options);
+    } else {
+        run<SC_State>(files, output_file, sublabels, points_per_label, batch_id, verbose, average, use_majority,
+                      options);
     }
-    auto finish = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> elapsed = finish - start;
-    std::cout << "Finished after " << elapsed.count() << " seconds.\n";
+}
+
+void AlphaLinkage::single_average(const std::vector<std::string> &files, const std::string &output_file,
+                                  const std::vector<double> &sublabels, int points_per_label, int batch_id,
+                                  bool verbose, bool average, bool use_majority, const LinkageOptions &options) {
+    run<SA_State>(files, output_file, sublabels, points_per_label, batch_id, verbose, average, use_majority, options);
+}
+
+void AlphaLinkage::average_complete(const std::vector<std::string> &files, const std::string &output_file,
+                                    const std::vector<double> &sublabels, int points_per_label, int batch_id,
+                                    bool verbose, bool average, bool use_majority, const LinkageOptions &options) {
+    run<AC_State>(files, output_file, sublabels, points_per_label, batch_id, verbose, average, use_majority, options);
 }
 
 void AlphaLinkage::single_complete_folder(const std::string &input_folder, const std::string &output_file,
                                           const std::vector<double> &sublabels, int points_per_label, int batch_id,
-                                          bool verbose, bool average, bool use_majority) {
+                                          bool verbose, bool average, bool use_majority,
+                                          const LinkageOptions &options) {
     std::vector<std::string> files = Helpers::get_files_in_folder(input_folder);
-    single_complete(files, output_file, sublabels, points_per_label, batch_id, verbose, average, use_majority);
+    single_complete(files, output_file, sublabels, points_per_label, batch_id, verbose, average, use_majority,
+                    options);
 }
 
 void AlphaLinkage::single_average_folder(const std::string &input_folder, const std::string &output_file,
                                          const std::vector<double> &sublabels, int points_per_label, int batch_id,
-                                         bool verbose, bool average, bool use_majority) {
+                                         bool verbose, bool average, bool use_majority,
+                                         const LinkageOptions &options) {
     std::vector<std::string> files = Helpers::get_files_in_folder(input_folder);
-    single_average(files, output_file, sublabels, points_per_label, batch_id, verbose, average, use_majority);
+    single_average(files, output_file, sublabels, points_per_label, batch_id, verbose, average, use_majority,
+                   options);
 }
 
 void AlphaLinkage::average_complete_folder(const std::string &input_folder, const std::string &output_file,
                                            const std::vector<double> &sublabels, int points_per_label, int batch_id,
-                                           bool verbose, bool average, bool use_majority) {
+                                           bool verbose, bool average, bool use_majority,
+                                           const LinkageOptions &options) {
     std::vector<std::string> files = Helpers::get_files_in_folder(input_folder);
-    average_complete(files, output_file, sublabels, points_per_label, batch_id, verbose, average, use_majority);
+    average_complete(files, output_file, sublabels, points_per_label, batch_id, verbose, average, use_majority,
+                     options);
 }
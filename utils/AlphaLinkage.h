@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 
+#include "LinkageOptions.h"
+
 namespace AlphaLinkage {
 
     /**
@@ -17,10 +19,11 @@ namespace AlphaLinkage {
      * @param verbose - output results to console
      * @param average - average over multiple files
      * @param use_majority - use majority cost instead of hamming cost
+     * @param options - tuning options of the linkage
      */
     void single_complete(const std::vector<std::string> &files, const std::string &output_file,
                          const std::vector<double> &sublabels, int points_per_label, int batch_id, bool verbose,
-                         bool average, bool use_majority);
+                         bool average, bool use_majority, const LinkageOptions &options);
 
     /**
      * Outputs all intervals and the according costs for the given input files into the given output file by interpolating
@@ -33,10 +36,11 @@ namespace AlphaLinkage {
      * @param verbose - output results to console
      * @param average - average over multiple files
      * @param use_majority - use majority cost instead of hamming cost
+     * @param options - tuning options of the linkage
      */
     void single_average(const std::vector<std::string> &files, const std::string &output_file,
                         const std::vector<double> &sublabels, int points_per_label, int batch_id, bool verbose,
-                        bool average, bool use_majority);
+                        bool average, bool use_majority, const LinkageOptions &options);
 
     /**
      * Outputs all intervals and the according costs for the given input files into the given output file by interpolating
@@ -49,10 +53,11 @@ namespace AlphaLinkage {
      * @param verbose - output results to console
      * @param average - average over multiple files
      * @param use_majority - use majority cost instead of hamming cost
+     * @param options - tuning options of the linkage
      */
     void average_complete(const std::vector<std::string> &files, const std::string &output_file,
                           const std::vector<double> &sublabels, int points_per_label, int batch_id, bool verbose,
-                          bool average, bool use_majority);
+                          bool average, bool use_majority, const LinkageOptions &options);
 
     /**
      * Evaluates all data files (.csv) in a given folder by interpolating between single and complete linkage and outputs
@@ -65,10 +70,11 @@ namespace AlphaLinkage {
      * @param verbose - output results to console
      * @param average - average over multiple files
      * @param use_majority - use majority cost instead of hamming cost
+     * @param options - tuning options of the linkage
      */
     void single_complete_folder(const std::string &input_folder, const std::string &output_file,
                                 const std::vector<double> &sublabels, int points_per_label, int batch_id, bool verbose,
-                                bool average, bool use_majority);
+                                bool average, bool use_majority, const LinkageOptions &options);
 
     /**
      * Evaluates all data files (.csv) in a given folder by interpolating between single and average linkage and outputs
@@ -81,10 +87,11 @@ namespace AlphaLinkage {
      * @param verbose - output results to console
      * @param average - average over multiple files
      * @param use_majority - use majority cost instead of hamming cost
+     * @param options - tuning options of the linkage
      */
     void single_average_folder(const std::string &input_folder, const std::string &output_file,
                                const std::vector<double> &sublabels, int points_per_label, int batch_id, bool verbose,
-                               bool average, bool use_majority);
+                               bool average, bool use_majority, const LinkageOptions &options);
 
     /**
      * Evaluates all data files (.csv) in a given folder by interpolating between average and complete linkage and outputs
@@ -97,10 +104,11 @@ namespace AlphaLinkage {
      * @param verbose - output results to console
      * @param average - average over multiple files
      * @param use_majority - use majority cost instead of hamming cost
+     * @param options - tuning options of the linkage
      */
     void average_complete_folder(const std::string &input_folder, const std::string &output_file,
                                  const std::vector<double> &sublabels, int points_per_label, int batch_id, bool verbose,
-                                 bool average, bool use_majority);
+                                 bool average, bool use_majority, const LinkageOptions &options);
 };
 
 #endif /* AlphaLinkage_h */  
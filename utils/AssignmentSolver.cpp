@@ -0,0 +1,172 @@
+#include "AssignmentSolver.h"
+
+#include <algorithm>
+#include <utility>
+
+/*!
+ * Dispatches small problems to the compile time specialized dynamic program and everything else to the Hungarian
+ * method. Transposes the matrix into the workspace if there are more rows than columns.
+ */
+double AssignmentSolver::solve(double const *costs, size_t rows, size_t cols) {
+    if (rows == 0 || cols == 0) {
+        return 0.0;
+    }
+    if (rows > cols) {
+        cost_.resize(rows * cols);
+        for (size_t r = 0; r < rows; r++) {
+            for (size_t c = 0; c < cols; c++) {
+                cost_[c * rows + r] = costs[r * cols + c];
+            }
+        }
+        costs = cost_.data();
+        std::swap(rows, cols);
+    }
+    switch (cols) {
+        case 1:
+            return AssignmentKernels::solve_dp<1>(costs, rows);
+        case 2:
+            return AssignmentKernels::solve_dp<2>(costs, rows);
+        case 3:
+            return AssignmentKernels::solve_dp<3>(costs, rows);
+        case 4:
+            return AssignmentKernels::solve_dp<4>(costs, rows);
+        case 5:
+            return AssignmentKernels::solve_dp<5>(costs, rows);
+        case 6:
+            return AssignmentKernels::solve_dp<6>(costs, rows);
+        case 7:
+            return AssignmentKernels::solve_dp<7>(costs, rows);
+        case 8:
+            return AssignmentKernels::solve_dp<8>(costs, rows);
+        default:
+            return solve_hungarian(costs, rows, cols);
+    }
+}
+
+double AssignmentSolver::hamming_cost(ClusterNode const *const *nodes, size_t n_nodes) {
+    return hamming_cost_of([nodes](size_t r) -> ClusterNode const & { return *nodes[r]; }, n_nodes);
+}
+
+double AssignmentSolver::hamming_cost(std::vector<ClusterNode> const &nodes) {
+    return hamming_cost_of([&nodes](size_t r) -> ClusterNode const & { return nodes[r]; }, nodes.size());
+}
+
+/*!
+ * Splits the problems into blocks of batch_block problems and runs the lane parallel dynamic program on each block.
+ * Shapes that are too large for the dynamic program are solved one by one with the Hungarian method.
+ */
+void AssignmentSolver::solve_batch(double const *costs, size_t n_problems, size_t rows, size_t cols, double *out) {
+    bool transposed = rows > cols;
+    size_t dp_rows = transposed ? cols : rows;
+    size_t dp_cols = transposed ? rows : cols;
+    if (dp_rows == 0) {
+        std::fill(out, out + n_problems, 0.0);
+        return;
+    }
+    if (dp_cols > max_dp_size) {
+        matrix_.resize(rows * cols);
+        for (size_t p = 0; p < n_problems; p++) {
+            for (size_t e = 0; e < rows * cols; e++) {
+                matrix_[e] = costs[e * n_problems + p];
+            }
+            out[p] = solve(matrix_.data(), rows, cols);
+        }
+        return;
+    }
+    batch_dp_.resize((1u << dp_cols) * batch_block);
+    for (size_t start = 0; start < n_problems; start += batch_block) {
+        size_t count = std::min(batch_block, n_problems - start);
+        double const *block = costs + start;
+        switch (dp_cols) {
+            case 1:
+                AssignmentKernels::solve_dp_batch<1, batch_block>(block, n_problems, dp_rows, transposed, count,
+                                                                  batch_dp_.data(), out + start);
+                break;
+            case 2:
+                AssignmentKernels::solve_dp_batch<2, batch_block>(block, n_problems, dp_rows, transposed, count,
+                                                                  batch_dp_.data(), out + start);
+                break;
+            case 3:
+                AssignmentKernels::solve_dp_batch<3, batch_block>(block, n_problems, dp_rows, transposed, count,
+                                                                  batch_dp_.data(), out + start);
+                break;
+            case 4:
+                AssignmentKernels::solve_dp_batch<4, batch_block>(block, n_problems, dp_rows, transposed, count,
+                                                                  batch_dp_.data(), out + start);
+                break;
+            case 5:
+                AssignmentKernels::solve_dp_batch<5, batch_block>(block, n_problems, dp_rows, transposed, count,
+                                                                  batch_dp_.data(), out + start);
+                break;
+            case 6:
+                AssignmentKernels::solve_dp_batch<6, batch_block>(block, n_problems, dp_rows, transposed, count,
+                                                                  batch_dp_.data(), out + start);
+                break;
+            case 7:
+                AssignmentKernels::solve_dp_batch<7, batch_block>(block, n_problems, dp_rows, transposed, count,
+                                                                  batch_dp_.data(), out + start);
+                break;
+            default:
+                AssignmentKernels::solve_dp_batch<8, batch_block>(block, n_problems, dp_rows, transposed, count,
+                                                                  batch_dp_.data(), out + start);
+                break;
+        }
+    }
+}
+
+/*!
+ * Potential based Hungarian method (O(rows^2 * cols)) for rows <= cols. The workspace vectors are only resized, so
+ * repeated calls with the same dimensions do not allocate.
+ */
+double AssignmentSolver::solve_hungarian(double const *costs, size_t rows, size_t cols) {
+    const double inf = std::numeric_limits<double>::infinity();
+    u_.assign(rows + 1, 0.0);
+    v_.assign(cols + 1, 0.0);
+    p_.assign(cols + 1, 0);
+    way_.assign(cols + 1, 0);
+    for (size_t i = 1; i <= rows; i++) {
+        p_[0] = (int) i;
+        size_t j0 = 0;
+        minv_.assign(cols + 1, inf);
+        used_.assign(cols + 1, 0);
+        do {
+            used_[j0] = 1;
+            size_t i0 = (size_t) p_[j0], j1 = 0;
+            double delta = inf;
+            for (size_t j = 1; j <= cols; j++) {
+                if (!used_[j]) {
+                    double cur = costs[(i0 - 1) * cols + (j - 1)] - u_[i0] - v_[j];
+                    if (cur < minv_[j]) {
+                        minv_[j] = cur;
+                        way_[j] = (int) j0;
+                    }
+                    if (minv_[j] < delta) {
+                        delta = minv_[j];
+                        j1 = j;
+                    }
+                }
+            }
+            for (size_t j = 0; j <= cols; j++) {
+                if (used_[j]) {
+                    u_[p_[j]] += delta;
+                    v_[j] -= delta;
+                } else {
+                    minv_[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while (p_[j0] != 0);
+        do {
+            size_t j1 = (size_t) way_[j0];
+            p_[j0] = p_[j1];
+            j0 = j1;
+        } while (j0);
+    }
+    double cost = 0.0;
+    for (size_t j = 1; j <= cols; j++) {
+        if (p_[j] != 0) {
+            cost += costs[(p_[j] - 1) * cols + (j - 1)];
+        }
+    }
+    return cost;
+}
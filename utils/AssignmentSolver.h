@@ -0,0 +1,190 @@
+#ifndef AssignmentSolver_h
+#define AssignmentSolver_h
+
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "ClusterNode.h"
+
+/*!
+ * Solves the (rectangular) linear assignment problem on a reusable workspace, so that repeated calls for the tiny k x k
+ * cost matrices of the hamming cost do not allocate. Problems with at most max_dp_size columns are solved by a bitmask
+ * dynamic program that is specialized at compile time for each size, larger ones by a potential based Hungarian method.
+ */
+class AssignmentSolver {
+public:
+    /// largest number of columns that is dispatched to the compile time specialized dynamic program
+    static const size_t max_dp_size = 8;
+
+    /// number of problems that are solved together in one block of the batched dynamic program
+    static const size_t batch_block = 64;
+
+    AssignmentSolver() {}
+
+    /**
+     * Calculates the optimal assignment cost for a row-major cost matrix. If there are more rows than columns, the
+     * matrix is transposed so that min(rows, cols) pairs get assigned, exactly like the HungarianAlgorithm does.
+     * @param costs - row-major cost matrix with rows * cols entries
+     * @param rows - number of rows
+     * @param cols - number of columns
+     * @return the cost of the optimal assignment
+     */
+    double solve(double const *costs, size_t rows, size_t cols);
+
+    /**
+     * Solves many independent assignment problems of the same shape at once. The cost matrices are given in a
+     * structure-of-arrays layout, i.e. entry (r, c) of problem p is stored at costs[(r * cols + c) * n_problems + p], so
+     * that the dynamic program can process one block of problems per SIMD loop.
+     * @param costs - all cost matrices in structure-of-arrays layout
+     * @param n_problems - number of cost matrices
+     * @param rows - number of rows of each matrix
+     * @param cols - number of columns of each matrix
+     * @param out - output array receiving the n_problems optimal costs
+     */
+    void solve_batch(double const *costs, size_t n_problems, size_t rows, size_t cols, double *out);
+
+    /**
+     * Calculates the hamming cost of the given clusters by reading their label counts directly, i.e. the optimal
+     * assignment for the cost matrix with entries (size of cluster r) - (count of label c in cluster r).
+     * @param nodes - the clusters of a pruning
+     * @param n_nodes - the number of clusters
+     * @return the hamming cost of the pruning
+     */
+    double hamming_cost(ClusterNode const *const *nodes, size_t n_nodes);
+
+    /**
+     * Calculates the hamming cost of the given clusters by reading their label counts directly.
+     * @param nodes - the clusters of a pruning
+     * @return the hamming cost of the pruning
+     */
+    double hamming_cost(std::vector<ClusterNode> const &nodes);
+
+private:
+    std::vector<double> batch_dp_;
+    std::vector<double> matrix_;
+    std::vector<double> cost_;
+    std::vector<double> u_;
+    std::vector<double> v_;
+    std::vector<double> minv_;
+    std::vector<int> p_;
+    std::vector<int> way_;
+    std::vector<char> used_;
+
+    double solve_hungarian(double const *costs, size_t rows, size_t cols);
+
+    /**
+     * Builds the hamming cost matrix of a pruning in the workspace straight from the label counts of its clusters.
+     * @tparam GetNode - callable returning the r-th cluster
+     * @param node - accessor for the clusters
+     * @param n_nodes - the number of clusters
+     * @return the hamming cost of the pruning
+     */
+    template<typename GetNode>
+    double hamming_cost_of(GetNode node, size_t n_nodes) {
+        if (n_nodes == 0) {
+            return 0.0;
+        }
+        size_t n_labels = node(0).counts.size();
+        matrix_.resize(n_nodes * n_labels);
+        for (size_t r = 0; r < n_nodes; r++) {
+            ClusterNode const &cluster = node(r);
+            int sum = 0;
+            for (size_t c = 0; c < n_labels; c++) {
+                sum += cluster.counts[c];
+            }
+            for (size_t c = 0; c < n_labels; c++) {
+                matrix_[r * n_labels + c] = (double) (sum - cluster.counts[c]);
+            }
+        }
+        return solve(matrix_.data(), n_nodes, n_labels);
+    }
+};
+
+namespace AssignmentKernels {
+
+    /**
+     * Bitmask dynamic program over the used columns of a rows x K cost matrix (rows <= K). dp[mask] holds the cheapest
+     * assignment of the first popcount(mask) rows to the columns in mask.
+     * @tparam K - number of columns, known at compile time
+     * @param costs - row-major cost matrix
+     * @param rows - number of rows
+     * @return the cost of the optimal assignment
+     */
+    template<size_t K>
+    inline double solve_dp(double const *costs, size_t rows) {
+        std::array<double, (1u << K)> dp;
+        dp.fill(std::numeric_limits<double>::infinity());
+        dp[0] = 0.0;
+        double best = std::numeric_limits<double>::infinity();
+        for (unsigned int mask = 0; mask < (1u << K); mask++) {
+            auto row = (size_t) __builtin_popcount(mask);
+            if (row == rows) {
+                best = dp[mask] < best ? dp[mask] : best;
+                continue;
+            }
+            double const *cost_row = costs + row * K;
+            for (size_t col = 0; col < K; col++) {
+                if (!(mask & (1u << col))) {
+                    double value = dp[mask] + cost_row[col];
+                    if (value < dp[mask | (1u << col)]) {
+                        dp[mask | (1u << col)] = value;
+                    }
+                }
+            }
+        }
+        return best;
+    }
+
+    /**
+     * Lane parallel version of solve_dp that runs the same dynamic program for a block of at most B problems, with the
+     * innermost loop running over the problems.
+     * @tparam K - number of columns, known at compile time
+     * @tparam B - maximum number of problems in a block
+     * @param costs - block start of the cost matrices in structure-of-arrays layout
+     * @param stride - distance between two consecutive matrix entries of the same problem
+     * @param rows - number of rows (<= K)
+     * @param transposed - whether the matrices are stored as K x rows and have to be read transposed
+     * @param count - number of problems in this block (<= B)
+     * @param dp - workspace of at least (1 << K) * B entries
+     * @param out - output array receiving the count optimal costs
+     */
+    template<size_t K, size_t B>
+    inline void solve_dp_batch(double const *costs, size_t stride, size_t rows, bool transposed, size_t count,
+                               double *dp, double *out) {
+        const double inf = std::numeric_limits<double>::infinity();
+        for (size_t i = 0; i < (1u << K) * B; i++) {
+            dp[i] = inf;
+        }
+        for (size_t p = 0; p < B; p++) {
+            dp[p] = 0.0;
+        }
+        for (size_t p = 0; p < count; p++) {
+            out[p] = inf;
+        }
+        for (unsigned int mask = 0; mask < (1u << K); mask++) {
+            auto row = (size_t) __builtin_popcount(mask);
+            double const *cur = dp + mask * B;
+            if (row == rows) {
+                for (size_t p = 0; p < count; p++) {
+                    out[p] = cur[p] < out[p] ? cur[p] : out[p];
+                }
+                continue;
+            }
+            for (size_t col = 0; col < K; col++) {
+                if (mask & (1u << col)) {
+                    continue;
+                }
+                double const *cost = costs + (transposed ? col * rows + row : row * K + col) * stride;
+                double *next = dp + (mask | (1u << col)) * B;
+                for (size_t p = 0; p < count; p++) {
+                    double value = cur[p] + cost[p];
+                    next[p] = value < next[p] ? value : next[p];
+                }
+            }
+        }
+    }
+}
+
+#endif /* AssignmentSolver_h */
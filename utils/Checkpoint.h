@@ -0,0 +1,480 @@
+#ifndef Checkpoint_h
+#define Checkpoint_h
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+
+#include "AlphaRange.h"
+#include "ClusterNode.h"
+#include "LinkageOptions.h"
+#include "SparseState.h"
+#include "State.h"
+
+#include "Spill.h"
+
+/// first bytes of every checkpoint file, followed by the format version
+const char checkpoint_magic[4] = {'L', 'L', 'C', 'P'};
+const uint32_t checkpoint_version = 3;
+
+namespace Checkpoint {
+
+    /*!
+     * Everything a sweep has emitted up to a checkpoint: the lengths of its output and execution tree files, the number
+     * of uncertain leaves and, when averaging, the ranges of every objective.
+     */
+    struct Progress {
+        uint64_t output_bytes;
+        uint64_t tree_bytes;
+        uint64_t uncertain;
+        std::vector<std::vector<AlphaRange> > columns;
+    };
+
+    /**
+     * Forces a written file to disk, so that it survives a reboot and not only the end of the process.
+     * @param path - the file
+     * @return if the file could be synchronized
+     */
+    inline bool sync(std::string const &path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        bool synced = ::fsync(fd) == 0;
+        ::close(fd);
+        return synced;
+    }
+
+    template<typename T>
+    void put(std::ostream &out, T const &value) {
+        out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    T get(std::istream &in) {
+        T value{};
+        in.read(reinterpret_cast<char *>(&value), sizeof(T));
+        return value;
+    }
+
+    template<typename T>
+    void put_vector(std::ostream &out, std::vector<T> const &values) {
+        put<uint64_t>(out, values.size());
+        out.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+    }
+
+    template<typename T>
+    void get_vector(std::istream &in, std::vector<T> &values) {
+        values.resize(get<uint64_t>(in));
+        in.read(reinterpret_cast<char *>(values.data()), values.size() * sizeof(T));
+    }
+
+    /**
+     * Writes all nodes that are reachable from the given ones, each only once however many states share it. Children
+     * are written before their parents and referenced by their number, parents are recreated from their children, so
+     * only leaves store their label counts.
+     * @param out - output stream
+     * @param nodes - the referenced nodes
+     * @param ids - receives the number of every written node
+     */
+    inline void put_nodes(std::ostream &out, std::vector<ClusterNode *> const &nodes,
+                          std::unordered_map<ClusterNode const *, uint64_t> &ids) {
+        std::vector<ClusterNode const *> todo;
+        for (ClusterNode const *root : nodes) {
+            todo.push_back(root);
+            while (!todo.empty()) {
+                ClusterNode const *node = todo.back();
+                if (ids.count(node)) {
+                    todo.pop_back();
+                } else if (node->has_children && (!ids.count(node->left) || !ids.count(node->right))) {
+                    todo.push_back(node->left);
+                    todo.push_back(node->right);
+                } else {
+                    put<uint8_t>(out, node->has_children);
+                    if (node->has_children) {
+                        put<uint64_t>(out, ids[node->left]);
+                        put<uint64_t>(out, ids[node->right]);
+                    } else {
+                        put_vector(out, std::vector<int>(node->counts.data(), node->counts.data() +
+                                                                              node->counts.size()));
+                    }
+                    ids.emplace(node, ids.size());
+                    todo.pop_back();
+                }
+            }
+        }
+    }
+
+    /**
+     * Writes the references of a state to its nodes.
+     * @param out - output stream
+     * @param nodes - the nodes of the state
+     * @param ids - the number of every written node
+     */
+    inline void put_refs(std::ostream &out, std::vector<ClusterNode *> const &nodes,
+                         std::unordered_map<ClusterNode const *, uint64_t> const &ids) {
+        std::vector<uint64_t> refs;
+        for (ClusterNode const *node : nodes) {
+            refs.push_back(ids.at(node));
+        }
+        put_vector(out, refs);
+    }
+
+    /**
+     * Reads the references of a state to its nodes.
+     * @param in - input stream
+     * @param pool - all read nodes by their number
+     * @return the nodes of the state
+     */
+    inline std::vector<ClusterNode *> get_refs(std::istream &in, std::vector<ClusterNode *> const &pool) {
+        std::vector<uint64_t> refs;
+        get_vector(in, refs);
+        std::vector<ClusterNode *> nodes;
+        for (uint64_t ref : refs) {
+            nodes.push_back(ref < pool.size() ? pool[ref] : nullptr);
+        }
+        return nodes;
+    }
+
+    /**
+     * Writes the fields of a state apart from its distances.
+     * @param out - output stream
+     * @param st - the state
+     * @param ids - the number of every written node
+     */
+    inline void put_fields(std::ostream &out, State const &st,
+                           std::unordered_map<ClusterNode const *, uint64_t> const &ids) {
+        put(out, st.alpha_min);
+        put(out, st.alpha_max);
+        put_vector(out, st.row_bounds);
+        put_vector(out, st.active_indices);
+        put_refs(out, st.nodes, ids);
+    }
+
+    inline void put_fields(std::ostream &out, SA_State const &st,
+                           std::unordered_map<ClusterNode const *, uint64_t> const &ids) {
+        put_fields(out, static_cast<State const &>(st), ids);
+        put_vector(out, st.cluster_sizes);
+    }
+
+    inline void put_fields(std::ostream &out, AC_State const &st,
+                           std::unordered_map<ClusterNode const *, uint64_t> const &ids) {
+        put_fields(out, static_cast<State const &>(st), ids);
+        put_vector(out, st.cluster_sizes);
+    }
+
+    inline void put_fields(std::ostream &out, SparseSC_State const &st,
+                           std::unordered_map<ClusterNode const *, uint64_t> const &ids) {
+        put(out, st.alpha_min);
+        put(out, st.alpha_max);
+        put_vector(out, st.row_bounds);
+        put_vector(out, st.radii);
+        put_vector(out, st.reach);
+        put<uint64_t>(out, st.members.size());
+        for (std::vector<long> const &members : st.members) {
+            put_vector(out, members);
+        }
+        put_vector(out, st.active_indices);
+        put_refs(out, st.nodes, ids);
+        put(out, st.edges);
+        put(out, st.incomplete);
+        put<uint8_t>(out, st.exact);
+    }
+
+    /**
+     * Reads the fields that were written by put_fields into an empty state.
+     * @param in - input stream
+     * @param st - receives the fields
+     * @param initial - the initial state of the sweep, which provides the layout
+     * @param pool - all read nodes by their number
+     */
+    inline void get_fields(std::istream &in, State &st, State const &initial, std::vector<ClusterNode *> const &pool) {
+        st.alpha_min = get<double>(in);
+        st.alpha_max = get<double>(in);
+        st.layout = initial.layout;
+        get_vector(in, st.row_bounds);
+        get_vector(in, st.active_indices);
+        st.nodes = get_refs(in, pool);
+    }
+
+    inline void get_fields(std::istream &in, SA_State &st, SA_State const &initial,
+                           std::vector<ClusterNode *> const &pool) {
+        get_fields(in, static_cast<State &>(st), initial, pool);
+        get_vector(in, st.cluster_sizes);
+    }
+
+    inline void get_fields(std::istream &in, AC_State &st, AC_State const &initial,
+                           std::vector<ClusterNode *> const &pool) {
+        get_fields(in, static_cast<State &>(st), initial, pool);
+        get_vector(in, st.cluster_sizes);
+    }
+
+    inline void get_fields(std::istream &in, SparseSC_State &st, SparseSC_State const &initial,
+                           std::vector<ClusterNode *> const &pool) {
+        st.alpha_min = get<double>(in);
+        st.alpha_max = get<double>(in);
+        get_vector(in, st.row_bounds);
+        get_vector(in, st.radii);
+        get_vector(in, st.reach);
+        st.members.resize(get<uint64_t>(in));
+        for (std::vector<long> &members : st.members) {
+            get_vector(in, members);
+        }
+        get_vector(in, st.active_indices);
+        st.nodes = get_refs(in, pool);
+        st.edges = get<long>(in);
+        st.incomplete = get<long>(in);
+        st.exact = get<uint8_t>(in) != 0;
+        st.points = initial.points;
+        st.rows.resize(initial.rows.size());
+    }
+
+    /**
+     * Describes the input of a sweep by the size and the modification time of its file and the selected points, so
+     * that a checkpoint is not resumed after the input changed.
+     * @param file - the input file
+     * @param sublabels - the classes of interest
+     * @param points_per_label - how many points of each class are used
+     * @param batch_id - indicates which batch gets used
+     * @param distance_labels - the labels file of precomputed distances, empty for feature files
+     * @return the description of the input
+     */
+    inline std::string input_id(std::string const &file, std::vector<double> const &sublabels, int points_per_label,
+                                int batch_id, std::string const &distance_labels) {
+        std::ostringstream id;
+        id.precision(17);
+        for (std::string const &path : {file, distance_labels}) {
+            struct stat info{};
+            if (!path.empty() && ::stat(path.c_str(), &info) == 0) {
+                id << (long long) info.st_size << ":" << (long long) info.st_mtime << ";";
+            } else {
+                id << "-;";
+            }
+        }
+        id << points_per_label << ";" << batch_id << ";";
+        for (double label : sublabels) {
+            id << label << ",";
+        }
+        return id.str();
+    }
+
+    /**
+     * Writes the kind of a state and the layout of its distances.
+     * @param out - output stream
+     * @param st - the state
+     */
+    inline void put_kind(std::ostream &out, SC_State const &st) {
+        put<uint8_t>(out, 0);
+        put<uint64_t>(out, st.layout.stride);
+    }
+
+    inline void put_kind(std::ostream &out, SA_State const &st) {
+        put<uint8_t>(out, 1);
+        put<uint64_t>(out, st.layout.stride);
+    }
+
+    inline void put_kind(std::ostream &out, AC_State const &st) {
+        put<uint8_t>(out, 2);
+        put<uint64_t>(out, st.layout.stride);
+    }
+
+    inline void put_kind(std::ostream &out, SparseSC_State const &) {
+        put<uint8_t>(out, 3);
+        put<uint64_t>(out, 0);
+    }
+
+    /**
+     * Writes the header that identifies the sweep of a checkpoint, i.e. everything that changes its results.
+     * @param out - output stream
+     * @param st - a state of the sweep, which provides its kind, its layout and the number of initial clusters
+     * @param objectives - the number of cost columns
+     * @param options - the interval of alpha and the options that change the results
+     * @param input - the description of the input by input_id
+     */
+    template<typename S>
+    void put_header(std::ostream &out, S const &st, size_t objectives, LinkageOptions const &options,
+                    std::string const &input) {
+        out.write(checkpoint_magic, sizeof(checkpoint_magic));
+        put(out, checkpoint_version);
+        put_kind(out, st);
+        put<uint64_t>(out, st.nodes.size());
+        put<uint64_t>(out, objectives);
+        put(out, options.alpha_start);
+        put(out, options.alpha_end);
+        put<uint8_t>(out, options.metric);
+        put<uint8_t>(out, options.batch_merges);
+        put<uint8_t>(out, options.collapse_duplicates);
+        put<uint64_t>(out, options.sparse_neighbours);
+        put<uint64_t>(out, options.coreset_size);
+        put_vector(out, options.focus);
+        put_vector(out, std::vector<char>(input.begin(), input.end()));
+    }
+
+    /**
+     * Writes the pending states of a sweep and its progress to a temporary file that then atomically replaces the
+     * checkpoint, so a crash while writing keeps the previous checkpoint. Spilled states are copied from their scratch
+     * files without loading them.
+     * @param path - the checkpoint file
+     * @param states - the pending states in the order of processing
+     * @param progress - the emitted results, whose files must already be on disk
+     * @param objectives - the number of cost columns
+     * @param options - the interval of alpha, the options that change the results and the scratch directory
+     * @param input - the description of the input by input_id
+     * @return if the checkpoint was replaced
+     */
+    template<typename S>
+    bool write(std::string const &path, std::vector<S> const &states, Progress const &progress, size_t objectives,
+               LinkageOptions const &options, std::string const &input) {
+        std::string temp = path + ".tmp";
+        std::ofstream out(temp, std::ios::binary);
+        put_header(out, states[0], objectives, options, input);
+        put(out, progress.output_bytes);
+        put(out, progress.tree_bytes);
+        put(out, progress.uncertain);
+        put<uint64_t>(out, progress.columns.size());
+        for (std::vector<AlphaRange> const &column : progress.columns) {
+            put<uint64_t>(out, column.size());
+            for (AlphaRange const &range : column) {
+                put(out, range.min);
+                put(out, range.max);
+                put(out, range.cost);
+            }
+        }
+
+        // all nodes of all states once, then the states referencing them
+        std::unordered_map<ClusterNode const *, uint64_t> ids;
+        for (S const &st : states) {
+            put_nodes(out, st.nodes, ids);
+        }
+        put<uint8_t>(out, 0xff);
+        put<uint64_t>(out, states.size());
+        for (S const &st : states) {
+            put_fields(out, st, ids);
+            if (st.spilled < 0) {
+                Spill::save(st, out);
+                continue;
+            }
+            std::ifstream in(Spill::file(options, st.spilled), std::ios::binary);
+            if (in.peek() != std::char_traits<char>::eof()) {
+                out << in.rdbuf();
+            }
+        }
+        out.close();
+        if (!out || !sync(temp) || std::rename(temp.c_str(), path.c_str()) != 0) {
+            std::remove(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Deletes the nodes that were read from a checkpoint that turned out to be unusable.
+     * @param pool - all read nodes by their number, is cleared
+     */
+    inline void release(std::vector<ClusterNode *> &pool) {
+        for (ClusterNode *node : pool) {
+            delete node;
+        }
+        pool.clear();
+    }
+
+    /**
+     * Reads the pending states and the progress of a sweep from its checkpoint. With a memory limit the states are
+     * spilled while they are read, so the limit also holds while resuming.
+     * @param path - the checkpoint file
+     * @param initial - the initial state of the sweep
+     * @param states - receives the pending states
+     * @param progress - receives the emitted results
+     * @param objectives - the number of cost columns
+     * @param options - the interval of alpha, the options that change the results, the memory limit and the scratch
+     * directory
+     * @param input - the description of the input by input_id
+     * @param next_id - the number of the next spilled state, is increased for every spilled state
+     * @return if the checkpoint belongs to the sweep and could be read
+     */
+    template<typename S>
+    bool read(std::string const &path, S const &initial, std::vector<S> &states, Progress &progress,
+              size_t objectives, LinkageOptions const &options, std::string const &input, long &next_id) {
+        std::ifstream in(path, std::ios::binary);
+        std::ostringstream expected;
+        put_header(expected, initial, objectives, options, input);
+        std::string header(expected.str().size(), '\0');
+        in.read(&header[0], (std::streamsize) header.size());
+        if (!in || header != expected.str()) {
+            return false;
+        }
+        progress.output_bytes = get<uint64_t>(in);
+        progress.tree_bytes = get<uint64_t>(in);
+        progress.uncertain = get<uint64_t>(in);
+        progress.columns.resize(get<uint64_t>(in));
+        for (std::vector<AlphaRange> &column : progress.columns) {
+            column.clear();
+            for (auto r = get<uint64_t>(in); r > 0 && in; r--) {
+                double min = get<double>(in);
+                double max = get<double>(in);
+                column.emplace_back(min, max, get<double>(in));
+            }
+        }
+
+        // recreate the shared nodes, parents from their children
+        std::vector<ClusterNode *> pool;
+        for (auto tag = get<uint8_t>(in); in && tag != 0xff; tag = get<uint8_t>(in)) {
+            if (tag) {
+                auto left = get<uint64_t>(in);
+                auto right = get<uint64_t>(in);
+                if (left >= pool.size() || right >= pool.size()) {
+                    release(pool);
+                    return false;
+                }
+                pool.push_back(new ClusterNode(pool[left], pool[right]));
+            } else {
+                std::vector<int> counts;
+                get_vector(in, counts);
+                pool.push_back(new ClusterNode(nullptr, nullptr, LabelCounts(counts), false));
+            }
+        }
+        states.clear();
+        for (auto count = get<uint64_t>(in); count > 0 && in; count--) {
+            states.emplace_back();
+            get_fields(in, states.back(), initial, pool);
+            Spill::read(states.back(), in);
+            if (options.memory_limit > 0) {
+                Spill::limit(states, options, next_id);
+            }
+        }
+        if (!in || states.empty()) {
+            // drop the scratch files of the states that were spilled so far
+            for (S const &st : states) {
+                if (st.spilled >= 0) {
+                    std::remove(Spill::file(options, st.spilled).c_str());
+                }
+            }
+            states.clear();
+            release(pool);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Cuts a file that is continued after a checkpoint back to its length at the checkpoint.
+     * @param path - the file
+     * @param bytes - its length at the checkpoint
+     * @return if the file was at least that long and could be cut
+     */
+    inline bool truncate(std::string const &path, uint64_t bytes) {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        return in && (uint64_t) in.tellg() >= bytes && ::truncate(path.c_str(), (off_t) bytes) == 0;
+    }
+}
+
+#endif /* Checkpoint_h */
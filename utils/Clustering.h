@@ -2,13 +2,23 @@
 #define Clustering_h
 
 #include "AlphaRange.h"
+#include "ExecutionTree.h"
 #include "Instersection.h"
+#include "LinkageOptions.h"
 #include "State.h"
 #include "SplitState.h"
 
+#include "Checkpoint.h"
+#include "CostPipeline.h"
+#include "Kernels.h"
 #include "Merge.h"
+#include "Parallel.h"
 #include "Prune.h"
+#include "Spill.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <stack>
 #include <string>
@@ -16,35 +26,59 @@
 
 namespace Clustering {
 
+    /// relative margin above which a row bound excludes all intersections of the row
+    const double intersection_bound_margin = 1e-9;
+
     /**
-      * Calculates the nearest interestion of a given linear function distance(alpha) based on the pairwise distances
-      * of all clusters.
-      * @param lower_dists - a distance vector that stores the pairwise distance for alpha = 0
-      * @param upper_dists - a distance vector that stores the pairwise distances for alpha = 1
+      * Calculates the nearest intersection of a given linear function with the distance functions of the pairs in the
+      * rows [first, last) of the active clusters. With vector kernels the nearest intersection of each row is found by
+      * Kernels::nearest_intersection.
+      * @param dists - the pairwise distance functions of all clusters
       * @param active_indices - all cluster indices that have not been merged
+      * @param first - position of the first row in active_indices
+      * @param last - position after the last row in active_indices
       * @param lf_in - the input linear function distance(alpha) which is used to calculate the next intersection
       * @param alpha_start - the current value of alpha
       * @param alpha_end - the maximum value of alpha in the given interval
-      * @param width - the width of the distance matrix, used to calculate indices in the flattened matrix that is given
-      * as vector
-      * @return the position of the nearest intersection together with the resulting linear function and the resulting
-      * merge clusters
+      * @param layout - the layout of the distance functions
+      * @param row_bounds - lower bounds of the rows' distances, rows entirely above lf_in are skipped
+      * @return the nearest intersection in the rows, alpha_end if there is none
       */
-    Intersection calculate_nearest_intersection(std::vector<double> const &lower_dists,
-                                                std::vector<double> const &upper_dists,
-                                                std::vector<long> const &active_indices,
-                                                LinearFunction lf_in,
-                                                double alpha_start, double alpha_end, size_t width) {
-        LinearFunction lf_out, lf_opt;
+    inline Intersection calculate_nearest_intersection(DistanceFunctions const &dists,
+                                                       std::vector<long> const &active_indices,
+                                                       size_t first, size_t last, LinearFunction lf_in,
+                                                       double alpha_start, double alpha_end,
+                                                       DistanceLayout const &layout,
+                                                       std::vector<double> const &row_bounds) {
+        LinearFunction lf_opt(0.0, 0.0);
         auto alpha_min = alpha_end;
-        long i1, i2;
+        long i1;
         MergeCandidate indices;
         double intersection;
-        for (auto i = 0; i < active_indices.size(); i++) {
-            i1 = Helpers::get_reduced_matrix_outter_index(width, active_indices[i]);
+
+        // a pair can only cross lf_in within the interval if it is not above lf_in's maximum there, the margin keeps
+        // pairs whose rounded intersection could still fall into the interval
+        double lf_in_max = std::max(lf_in.b + alpha_start * lf_in.a, lf_in.b + alpha_end * lf_in.a);
+        double limit = lf_in_max + intersection_bound_margin * std::max(1.0, std::abs(lf_in_max));
+        for (auto i = first; i < last; i++) {
+            if (row_bounds[active_indices[i]] > limit) {
+                continue;
+            }
+            i1 = layout.row_base(active_indices[i]);
+            if (Kernels::vectorized()) {
+                Kernels::RowNearest row = Kernels::nearest_intersection(dists.data(), i1,
+                                                                        active_indices.data() + i + 1,
+                                                                        active_indices.size() - i - 1, lf_in,
+                                                                        alpha_start, alpha_min);
+                if (row.position != Kernels::no_position) {
+                    indices = MergeCandidate(active_indices[i], active_indices[i + 1 + row.position]);
+                    alpha_min = row.alpha;
+                    lf_opt = dists[i1 + indices.cluster2].function();
+                }
+                continue;
+            }
             for (auto j = i + 1; j < active_indices.size(); j++) {
-                i2 = i1 + active_indices[j];
-                lf_out = LinearFunction(upper_dists[i2] - lower_dists[i2], lower_dists[i2]);
+                LinearFunction lf_out = dists[i1 + active_indices[j]].function();
                 intersection = lf_in.calculate_interaction_with(lf_out);
                 if (intersection < alpha_min && intersection > alpha_start) {
                     indices = MergeCandidate(active_indices[i], active_indices[j]);
@@ -56,31 +90,71 @@ namespace Clustering {
         return {alpha_min, lf_opt, indices};
     }
 
+    /**
+      * Calculates the nearest interestion of a given linear function distance(alpha) based on the pairwise distances
+      * of all clusters. With more than one thread the rows are split into ranges with equally many pairs whose
+      * intersections are reduced in row order, which keeps the first of several equally near intersections.
+      * @param dists - the pairwise distance functions of all clusters
+      * @param active_indices - all cluster indices that have not been merged
+      * @param lf_in - the input linear function distance(alpha) which is used to calculate the next intersection
+      * @param alpha_start - the current value of alpha
+      * @param alpha_end - the maximum value of alpha in the given interval
+      * @param layout - the layout of the distance functions
+      * @param row_bounds - lower bounds of the rows' distances
+      * @param threads - the number of threads used for the scan
+      * @return the position of the nearest intersection together with the resulting linear function and the resulting
+      * merge clusters
+      */
+    inline Intersection calculate_nearest_intersection(DistanceFunctions const &dists,
+                                                       std::vector<long> const &active_indices,
+                                                       LinearFunction lf_in,
+                                                       double alpha_start, double alpha_end,
+                                                       DistanceLayout const &layout,
+                                                       std::vector<double> const &row_bounds, size_t threads = 1) {
+        if (threads <= 1) {
+            return calculate_nearest_intersection(dists, active_indices, 0, active_indices.size(), lf_in, alpha_start,
+                                                  alpha_end, layout, row_bounds);
+        }
+        std::vector<size_t> bounds = Parallel::triangle_chunks(active_indices.size(), threads);
+        std::vector<Intersection> nearest(threads);
+        Parallel::run_chunks(threads, [&](size_t c) {
+            nearest[c] = calculate_nearest_intersection(dists, active_indices, bounds[c], bounds[c + 1], lf_in,
+                                                        alpha_start, alpha_end, layout, row_bounds);
+        });
+        Intersection is = nearest[0];
+        for (size_t c = 1; c < threads; c++) {
+            if (nearest[c].alpha < is.alpha) {
+                is = nearest[c];
+            }
+        }
+        return is;
+    }
+
     /**
      * Calculates all children nodes for a parent node.
      * @param min - the search space's lower alpha bound
      * @param max - the search space's upper alpha bound
-     * @param lower_dists - the pairwise distances for alpha = 0
-     * @param upper_dists - the pairwise distances for alpha = 1
+     * @param dists - the pairwise distance functions of all clusters
      * @param active_indices - the incdices of all clusters that were not merged yet
-     * @param size - the size of the pairwise distance matrix that was flattened
+     * @param layout - the layout of the distance functions
+     * @param row_bounds - lower bounds of the rows' distances within [min, max]
      * @param states - the parent state that will be overwritten by the children states
+     * @param threads - the number of threads used for the scans
      */
-    void getsplitstates(double min, double max, std::vector<double> const &lower_dists,
-                        std::vector<double> const &upper_dists,
-                        std::vector<long> const &active_indices, size_t size,
-                        std::vector<SplitState> &states) {
-        std::pair<LinearFunction, MergeCandidate> lower = find_merge_candidates(lower_dists, upper_dists,
-                                                                                active_indices, min, size);
-        std::pair<LinearFunction, MergeCandidate> upper = find_merge_candidates(lower_dists, upper_dists,
-                                                                                active_indices, max, size);
+    inline void getsplitstates(double min, double max, DistanceFunctions const &dists,
+                               std::vector<long> const &active_indices, DistanceLayout const &layout,
+                               std::vector<double> &row_bounds, std::vector<SplitState> &states,
+                               size_t threads = 1) {
+        auto candidates = find_merge_candidates(dists, active_indices, min, max, layout, row_bounds, threads);
+        std::pair<LinearFunction, MergeCandidate> lower = candidates.first;
+        std::pair<LinearFunction, MergeCandidate> upper = candidates.second;
         if (std::get<1>(lower).cluster1 != std::get<1>(upper).cluster1 ||
             std::get<1>(lower).cluster2 != std::get<1>(upper).cluster2) {
             Intersection is;
             auto alpha = min;
             while (alpha < max) {
-                is = calculate_nearest_intersection(lower_dists, upper_dists, active_indices, std::get<0>(lower), alpha,
-                                                    max, size);
+                is = calculate_nearest_intersection(dists, active_indices, std::get<0>(lower), alpha, max, layout,
+                                                    row_bounds, threads);
                 states.emplace_back(std::get<1>(lower), alpha, is.alpha);
                 lower = std::pair<LinearFunction, MergeCandidate>(is.next_function, is.next_merge);
                 alpha = is.alpha;
@@ -90,6 +164,136 @@ namespace Clustering {
         }
     }
 
+    /**
+     * Calculates all children nodes for a parent state on its interval.
+     * @param st - the parent state
+     * @param states - receives the children states
+     * @param threads - the number of threads used for the scans
+     */
+    inline void getsplitstates(State &st, std::vector<SplitState> &states, size_t threads = 1) {
+        getsplitstates(st.alpha_min, st.alpha_max, st.dists, st.active_indices, st.layout, st.row_bounds, states,
+                       threads);
+    }
+
+    /**
+     * Checks whether the clustering of a state is certainly the one of the exact linkage, which always holds if all
+     * distances are known.
+     * @param st - current state
+     * @return true
+     */
+    inline bool is_exact(State const &st) {
+        return true;
+    }
+
+    /**
+     * Restricts a range to the focus intervals of the options.
+     * @param range - a range of alpha with its cost
+     * @param options - tuning options of the linkage
+     * @return the parts of the range that overlap a focus interval, the range itself without focus intervals
+     */
+    inline std::vector<AlphaRange> focus_ranges(AlphaRange const &range, const LinkageOptions &options) {
+        if (options.focus.empty()) {
+            return {range};
+        }
+        std::vector<AlphaRange> parts;
+        for (auto const &interval : options.focus) {
+            double min = std::max(range.min, interval.first);
+            double max = std::min(range.max, interval.second);
+            if (min < max) {
+                parts.emplace_back(min, max, range.cost);
+            }
+        }
+        return parts;
+    }
+
+    /**
+     * Performs one step of a state of the tree of executions, i.e. merges all certified pairs at once (reducible
+     * linkages only) or, if there are none, replaces the state by its children, one for each merge candidate of its
+     * interval that overlaps the focus intervals. The children take the state's position in the given order of alpha.
+     * @param states - the states of the tree of executions
+     * @param index - position of the expanded state, which has more than one active cluster
+     * @param options - tuning options of the linkage
+     * @param tree - records the step if given
+     * @return the number of states that replaced the expanded one, 0 if it was dropped
+     */
+    template<typename S>
+    size_t expand(std::vector<S> &states, size_t index, const LinkageOptions &options,
+                  ExecutionTreeWriter *tree = nullptr) {
+        // states with many active clusters split their scans and distance updates across threads
+        size_t threads = states[index].active_indices.size() >= options.parallel_min_active ? options.threads : 1;
+
+        // merge all pairs that are certified for the whole interval at once, then look for the next batch
+        if (S::reducible && options.batch_merges) {
+            std::vector<MergeCandidate> certified = find_certified_merges(states[index], threads);
+            for (MergeCandidate const &merge : certified) {
+                merge_clusters(states[index], merge.cluster1, merge.cluster2, threads);
+                if (tree) {
+                    tree->merge(merge.cluster1, merge.cluster2);
+                }
+            }
+            if (!certified.empty()) {
+                return 1;
+            }
+        }
+        std::vector<SplitState> splitstates;
+        getsplitstates(states[index], splitstates, threads);
+
+        // children outside of the focus intervals are pruned, a state without any child in them is dropped
+        splitstates.erase(std::remove_if(splitstates.begin(), splitstates.end(), [&](SplitState const &split) {
+            return focus_ranges(AlphaRange(split.alpha_min, split.alpha_max, 0.0), options).empty();
+        }), splitstates.end());
+        if (splitstates.empty()) {
+            states.erase(states.begin() + index);
+            return 0;
+        }
+        if (tree) {
+            tree->split(splitstates);
+        }
+
+        // every child is narrowed to its interval before its merge, so the merge sees the child's interval
+        for (auto j = 0; j < splitstates.size() - 1; ++j) {
+            S temp = states[index + j];
+            temp.alpha_min = splitstates[j].alpha_min;
+            temp.alpha_max = splitstates[j].alpha_max;
+            merge_clusters(temp, splitstates[j].merge_candidate.cluster1,
+                           splitstates[j].merge_candidate.cluster2, threads);
+            states.insert(states.begin() + index + j, std::move(temp));
+        }
+        // overwrite the parent node with the last child for better performance
+        S &last = states[index + splitstates.size() - 1];
+        last.alpha_min = splitstates.back().alpha_min;
+        last.alpha_max = splitstates.back().alpha_max;
+        merge_clusters(last, splitstates.back().merge_candidate.cluster1, splitstates.back().merge_candidate.cluster2,
+                       threads);
+        return splitstates.size();
+    }
+
+    /**
+     * Explores the top of the tree of executions breadth first, i.e. performs one step of every state per round, until
+     * there are at least min_states states or all of them are leaves.
+     * @param states - the states of the tree of executions, ordered by alpha, receives the explored states
+     * @param min_states - the number of states at which the exploration stops
+     * @param options - tuning options of the linkage
+     */
+    template<typename S>
+    void explore(std::vector<S> &states, size_t min_states, const LinkageOptions &options) {
+        bool expanded = true;
+        while (expanded && states.size() < min_states) {
+            expanded = false;
+            for (size_t index = 0; index < states.size() && states.size() < min_states;) {
+                if (states[index].active_indices.size() > 1) {
+                    index += expand(states, index, options);
+                    expanded = true;
+                } else {
+                    index++;
+                }
+            }
+        }
+    }
+
+    /// number of leaves per cost worker that may be in flight before the exploration waits for the workers
+    const size_t cost_queue_leaves = 64;
+
     /**
      * Finds all intervals by interpolating depending on the given input state and returns them as a vector<AlphaRange>.
      * @param states - a vector of states containing the input state
@@ -99,49 +303,120 @@ namespace Clustering {
      * @param verbose - output directly to console
      * @param average - calculate average over multiple files
      * @param use_majority - use majority cost instead of hamming cost
-     * @return a vector with all ranges that contain an interval [a_min, a_max] and a loss value for each interval
+     * @param options - tuning options of the linkage
+     * @param tree_file - the file the tree of executions is written into, none if empty
+     * @param checkpoint_file - the file the sweep is periodically checkpointed into and resumed from, none if empty
+     * @param checkpoint_input - the description of the input by Checkpoint::input_id, a checkpoint of another input
+     * is not resumed
+     * @param objective_ranges - receives the ranges of every objective of options.objectives if given
+     * @return a vector with all ranges that contain an interval [a_min, a_max] and a loss value for each interval, i.e.
+     * the cost of the first objective if several are given
      */
     template<typename S>
     std::vector<AlphaRange>
     getranges(std::vector<S> states, std::string output_file, unsigned long labels_size,
-              unsigned long maxlabel, bool verbose, bool average, bool use_majority) {
-        std::vector<AlphaRange> ranges;
-        std::ofstream myfile;
-        if (!output_file.empty()) {
-            myfile.open(output_file);
+              unsigned long maxlabel, bool verbose, bool average, bool use_majority, const LinkageOptions &options,
+              std::string const &tree_file = "", std::string const &checkpoint_file = "",
+              std::string const &checkpoint_input = "",
+              std::vector<std::vector<AlphaRange> > *objective_ranges = nullptr) {
+        // every leaf is written with the costs of all objectives, by default only the chosen cost for all labels
+        std::vector<Objective> objectives = options.objectives;
+        if (objectives.empty()) {
+            objectives.emplace_back(use_majority, maxlabel);
         }
-        while (!states.empty()) {
-
-            // leaf node
-            if (states[0].active_indices.size() == 1) {
-                double cost;
+        std::vector<std::vector<AlphaRange> > columns(objectives.size());
+        size_t uncertain = 0;
+        long spill_id = 0;
 
-                // calculate majority cost
-                if (use_majority) {
-                    std::map<int, Pruning> pruning_strats = prune(*states[0].nodes[*states[0].active_indices.begin()],
-                                                                  maxlabel);
-                    cost = pruning_strats.find(maxlabel)->second.cost / (double) labels_size;
+        // continue from the checkpoint if its output and tree files are still at least as long as they were then
+        Checkpoint::Progress progress{0, 0, 0, {}};
+        bool resumed = false;
+        if (options.resume && !checkpoint_file.empty() && std::ifstream(checkpoint_file).good()) {
+            std::vector<S> pending;
+            if (Checkpoint::read(checkpoint_file, states[0], pending, progress, objectives.size(), options,
+                                 checkpoint_input, spill_id) &&
+                (average || output_file.empty() || Checkpoint::truncate(output_file, progress.output_bytes)) &&
+                (tree_file.empty() || (progress.tree_bytes > 0 && Checkpoint::truncate(tree_file,
+                                                                                       progress.tree_bytes)))) {
+                std::cout << "Resuming from " << checkpoint_file << " with " << pending.size() << " pending states."
+                          << std::endl;
+                states = std::move(pending);
+                uncertain = progress.uncertain;
+                if (average) {
+                    columns = progress.columns;
                 }
-
-                    // calculate hamming cost
-                else {
-                    cost = best_pruning(*states[0].nodes[*states[0].active_indices.begin()], maxlabel).cost /
-                           (double) labels_size;
+                resumed = true;
+            } else {
+                std::cerr << "Warning: " << checkpoint_file << " does not match this run, starting over." << std::endl;
+                for (S const &st : pending) {
+                    if (st.spilled >= 0) {
+                        std::remove(Spill::file(options, st.spilled).c_str());
+                    }
                 }
+            }
+        }
+        std::ofstream myfile;
+        if (!output_file.empty()) {
+            myfile.open(output_file, resumed && !average ? std::ios::app : std::ios::out);
+        }
+        ExecutionTreeWriter tree;
+        if (!tree_file.empty() && !(resumed ? tree.reopen(tree_file) : tree.open(tree_file, states[0].nodes))) {
+            std::cerr << "Warning: the tree of executions cannot be written to " << tree_file << "." << std::endl;
+        }
 
+        // the leaves are scored by the cost workers while the exploration continues and sunk in their order
+        CostPipeline pipeline(options.cost_threads, options.cost_threads * cost_queue_leaves,
+                              [&](NodeStore const &store, AssignmentSolver &solver) {
+            // calculate the costs of all objectives on one flattened tree
+            std::vector<double> costs = objective_costs(store, objectives, solver);
+            for (double &cost : costs) {
+                cost /= (double) labels_size;
+            }
+            return costs;
+        }, [&](LeafCosts const &leaf) {
+            for (AlphaRange const &range : focus_ranges(AlphaRange(leaf.alpha_min, leaf.alpha_max, leaf.costs[0]),
+                                                        options)) {
                 // store range
                 if (average) {
-                    ranges.emplace_back(states[0].alpha_min, states[0].alpha_max, cost);
+                    for (size_t o = 0; o < leaf.costs.size(); o++) {
+                        columns[o].emplace_back(range.min, range.max, leaf.costs[o]);
+                    }
                 }
 
                     // output range to file
                 else if (!output_file.empty()) {
-                    myfile << states[0].alpha_min << "," << states[0].alpha_max << "," << cost << "\n";
+                    myfile << range.min << "," << range.max;
+                    for (double cost : leaf.costs) {
+                        myfile << "," << cost;
+                    }
+                    myfile << "\n";
                 }
 
                 // output range to console
                 if (verbose) {
-                    std::cout << states[0].alpha_min << "," << states[0].alpha_max << "," << cost << std::endl;
+                    std::cout << range.min << "," << range.max;
+                    for (double cost : leaf.costs) {
+                        std::cout << "," << cost;
+                    }
+                    std::cout << (leaf.exact ? "" : " (uncertain)") << std::endl;
+                }
+            }
+            if (!leaf.exact) {
+                uncertain++;
+            }
+        });
+        auto last_checkpoint = std::chrono::steady_clock::now();
+        while (!states.empty()) {
+            if (states[0].spilled >= 0) {
+                Spill::restore(states[0], options);
+            }
+
+            // leaf node
+            if (states[0].active_indices.size() == 1) {
+                pipeline.push(states[0].nodes[*states[0].active_indices.begin()], states[0].alpha_min,
+                              states[0].alpha_max, is_exact(states[0]));
+                if (tree.is_open()) {
+                    tree.leaf(states[0].alpha_min, states[0].alpha_max);
                 }
                 states.erase(std::remove(states.begin(), states.end(), states[0]), states.end());
             }
@@ -151,28 +426,53 @@ namespace Clustering {
 
                 // take first element from the tree of executions and calculate resulting children
                 // (a node can result in 1, 2 or more children)
-                std::vector<SplitState> splitstates;
-                getsplitstates(states[0].alpha_min, states[0].alpha_max, states[0].lower_dists,
-                               states[0].upper_dists, states[0].active_indices, labels_size, splitstates);
-                for (auto j = 0; j < splitstates.size() - 1; ++j) {
-                    S temp = states[j];
-                    merge_clusters(temp, splitstates[j].merge_candidate.cluster1,
-                                   splitstates[j].merge_candidate.cluster2,
-                                   labels_size);
-                    temp.alpha_min = splitstates[j].alpha_min;
-                    temp.alpha_max = splitstates[j].alpha_max;
-                    states.insert(states.begin() + j, temp);
+                expand(states, 0, options, tree.is_open() ? &tree : nullptr);
+
+                // spill the coldest states if the pending ones hold too many bytes
+                if (options.memory_limit > 0) {
+                    Spill::limit(states, options, spill_id);
                 }
-                // overwrite the parent node with the last child for better performance
-                merge_clusters(states[splitstates.size() - 1],
-                               splitstates[splitstates.size() - 1].merge_candidate.cluster1,
-                               splitstates[splitstates.size() - 1].merge_candidate.cluster2, labels_size);
-                states[splitstates.size() - 1].alpha_min = splitstates[splitstates.size() - 1].alpha_min;
-                states[splitstates.size() - 1].alpha_max = splitstates[splitstates.size() - 1].alpha_max;
+            }
+
+            // checkpoint the pending states once all pushed leaves are emitted and on disk
+            if (options.checkpoint_interval > 0 && !checkpoint_file.empty() && !states.empty() &&
+                std::chrono::steady_clock::now() - last_checkpoint >=
+                std::chrono::seconds(options.checkpoint_interval)) {
+                pipeline.drain();
+                if (myfile.is_open()) {
+                    myfile.flush();
+                    progress.output_bytes = (uint64_t) myfile.tellp();
+                    Checkpoint::sync(output_file);
+                }
+                if (tree.is_open()) {
+                    progress.tree_bytes = tree.flush();
+                    Checkpoint::sync(tree_file);
+                }
+                progress.uncertain = uncertain;
+                if (average) {
+                    progress.columns = columns;
+                }
+                if (!Checkpoint::write(checkpoint_file, states, progress, objectives.size(), options,
+                                       checkpoint_input)) {
+                    std::cerr << "Warning: the checkpoint cannot be written to " << checkpoint_file << "."
+                              << std::endl;
+                }
+                last_checkpoint = std::chrono::steady_clock::now();
             }
         }
+        pipeline.finish();
         myfile.close();
-        return ranges;
+        if (!checkpoint_file.empty()) {
+            std::remove(checkpoint_file.c_str());
+        }
+        if (uncertain > 0) {
+            std::cout << "Warning: the unknown distances of the sparse neighbour graph could have changed "
+                      << uncertain << " ranges." << std::endl;
+        }
+        if (objective_ranges) {
+            *objective_ranges = columns;
+        }
+        return columns[0];
     }
 };
 
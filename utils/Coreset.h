@@ -0,0 +1,169 @@
+#ifndef Coreset_h
+#define Coreset_h
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "Parallel.h"
+
+namespace Coreset {
+
+    /// number of Lloyd iterations that refine the k-means++ seeding
+    const int refine_iterations = 3;
+
+    /// number of points of the sample on which the error of a coreset is estimated
+    const size_t sample_points = 256;
+
+    /// seed of all random choices, which keeps the coresets of repeated runs identical
+    const unsigned int seed = 0;
+
+    /**
+     * Calculates the squared euclidean distance between two vectors.
+     * @tparam T - numeric feature type
+     * @param a - first vector
+     * @param b - second vector
+     * @return the squared distance
+     */
+    template<typename T>
+    inline double squared_dist(std::vector<T> const &a, std::vector<T> const &b) {
+        double d = 0.0;
+        for (size_t dim = 0; dim < a.size(); dim++) {
+            double diff = a[dim] - b[dim];
+            d += diff * diff;
+        }
+        return d;
+    }
+
+    /**
+     * Assigns every point to its nearest center, the first one on ties. The points are split into ranges that are
+     * assigned in parallel.
+     * @tparam T - numeric feature type
+     * @param feature_vectors - all points
+     * @param centers - all centers
+     * @param threads - the number of threads
+     * @return the index of the nearest center of each point
+     */
+    template<typename T>
+    std::vector<size_t> assign(std::vector<std::vector<T> > const &feature_vectors,
+                               std::vector<std::vector<T> > const &centers, size_t threads) {
+        std::vector<size_t> nearest(feature_vectors.size(), 0);
+        size_t chunk = (feature_vectors.size() + threads - 1) / threads;
+        Parallel::run_chunks(threads, [&](size_t c) {
+            for (size_t p = c * chunk; p < std::min(feature_vectors.size(), (c + 1) * chunk); p++) {
+                double best = std::numeric_limits<double>::infinity();
+                for (size_t center = 0; center < centers.size(); center++) {
+                    double d = squared_dist(feature_vectors[p], centers[center]);
+                    if (d < best) {
+                        best = d;
+                        nearest[p] = center;
+                    }
+                }
+            }
+        });
+        return nearest;
+    }
+
+    /**
+     * Reduces the points to weighted representatives by k-means++ seeding followed by refine_iterations Lloyd
+     * iterations. Every representative is the centroid of the points assigned to it, its weight and label histogram
+     * are given by these points. Centers that end up without points are dropped.
+     * @tparam T - numeric feature type
+     * @param feature_vectors - all points
+     * @param size - the number of representatives
+     * @param threads - the number of threads
+     * @param groups - receives the points of each representative in ascending order, ordered by their first point
+     * @param representatives - receives the centroid of each group
+     */
+    template<typename T>
+    void getgroups(std::vector<std::vector<T> > const &feature_vectors, size_t size, size_t threads,
+                   std::vector<std::vector<size_t> > &groups, std::vector<std::vector<T> > &representatives) {
+        size_t len = feature_vectors.size();
+        threads = std::max<size_t>(1, std::min(threads, len));
+        size_t chunk = (len + threads - 1) / threads;
+        std::mt19937_64 random(seed);
+
+        // k-means++ seeding, every next center is drawn with probability proportional to the squared distance of a
+        // point to its nearest center so far
+        std::vector<std::vector<T> > centers;
+        centers.push_back(feature_vectors[std::uniform_int_distribution<size_t>(0, len - 1)(random)]);
+        std::vector<double> nearest(len, std::numeric_limits<double>::infinity());
+        while (centers.size() < size) {
+            std::vector<double> sums(threads, 0.0);
+            Parallel::run_chunks(threads, [&](size_t c) {
+                for (size_t p = c * chunk; p < std::min(len, (c + 1) * chunk); p++) {
+                    nearest[p] = std::min(nearest[p], squared_dist(feature_vectors[p], centers.back()));
+                    sums[c] += nearest[p];
+                }
+            });
+            double total = 0.0;
+            for (double sum : sums) {
+                total += sum;
+            }
+            if (total <= 0.0) {
+                break;
+            }
+            double target = std::uniform_real_distribution<double>(0.0, total)(random);
+            size_t next = 0;
+            for (; next + 1 < len && target >= nearest[next]; next++) {
+                target -= nearest[next];
+            }
+            centers.push_back(feature_vectors[next]);
+        }
+
+        // Lloyd iterations move every center to the centroid of its points
+        std::vector<size_t> assignment;
+        for (int iteration = 0; iteration <= refine_iterations; iteration++) {
+            assignment = assign(feature_vectors, centers, threads);
+            std::vector<std::vector<double> > sums(centers.size(), std::vector<double>(feature_vectors[0].size(), 0.0));
+            std::vector<size_t> counts(centers.size(), 0);
+            for (size_t p = 0; p < len; p++) {
+                for (size_t dim = 0; dim < sums[assignment[p]].size(); dim++) {
+                    sums[assignment[p]][dim] += feature_vectors[p][dim];
+                }
+                counts[assignment[p]]++;
+            }
+            for (size_t center = 0; center < centers.size(); center++) {
+                for (size_t dim = 0; counts[center] > 0 && dim < sums[center].size(); dim++) {
+                    centers[center][dim] = (T) (sums[center][dim] / (double) counts[center]);
+                }
+            }
+        }
+
+        // the groups follow the order of their first points, the last update made each center a centroid
+        std::vector<size_t> group_of(centers.size(), std::numeric_limits<size_t>::max());
+        groups.clear();
+        representatives.clear();
+        for (size_t p = 0; p < len; p++) {
+            size_t &group = group_of[assignment[p]];
+            if (group == std::numeric_limits<size_t>::max()) {
+                group = groups.size();
+                groups.emplace_back();
+                representatives.push_back(centers[assignment[p]]);
+            }
+            groups[group].push_back(p);
+        }
+    }
+
+    /**
+     * Draws a uniform sample of points.
+     * @param len - the number of points
+     * @param size - the size of the sample
+     * @return the indices of the sampled points in ascending order
+     */
+    inline std::vector<size_t> getsample(size_t len, size_t size) {
+        std::vector<size_t> indices(len);
+        for (size_t p = 0; p < len; p++) {
+            indices[p] = p;
+        }
+        std::mt19937_64 random(seed);
+        std::shuffle(indices.begin(), indices.end(), random);
+        indices.resize(std::min(len, size));
+        std::sort(indices.begin(), indices.end());
+        return indices;
+    }
+}
+
+#endif /* Coreset_h */
@@ -2,7 +2,6 @@
 
 #include <algorithm>
 #include <numeric>
-#include "../lib/Hungarian.h"
 
 
 /*!
@@ -15,20 +14,79 @@ double CostFunction::majority_cost(ClusterNode const &node) {
 }
 
 /*!
- * Hamming cost calculates the costs with an optimal matching between a generated and a target clustering using the
- * hungarian algorithm (https://en.wikipedia.org/wiki/Hungarian_algorithm).
+ * Majority cost of a node given by a row of the store's counts matrix.
  */
-double CostFunction::hamming_cost(std::vector<ClusterNode> nodes) {
-    std::vector<std::vector<double> > cost_matrix;
-    for (ClusterNode node : nodes) {
-        std::vector<double> cur_cost;
-        int sum = std::accumulate(node.counts.begin(), node.counts.end(), 0);
-        for (auto count : node.counts) {
-            cur_cost.push_back((double) (sum - count));
+double CostFunction::majority_cost(NodeStore const &store, uint32_t node) {
+    int const *row = store.counts_of(node);
+    return std::accumulate(row, row + store.k, 0) - *std::max_element(row, row + store.k);
+}
+
+/*!
+ * Hamming cost calculates the costs with an optimal matching between a generated and a target clustering
+ * (https://en.wikipedia.org/wiki/Hungarian_algorithm).
+ */
+double CostFunction::hamming_cost(std::vector<ClusterNode> const &nodes) {
+    AssignmentSolver solver;
+    return hamming_cost(nodes, solver);
+}
+
+/*!
+ * The cost matrix is read directly from the label counts of the nodes, so no intermediate matrix gets allocated.
+ */
+double CostFunction::hamming_cost(std::vector<ClusterNode> const &nodes, AssignmentSolver &solver) {
+    return solver.hamming_cost(nodes);
+}
+
+/*!
+ * The cost matrices are stored in the structure-of-arrays layout of AssignmentSolver::solve_batch, i.e. entry (r, c) of
+ * all prunings lies contiguously in memory.
+ */
+std::vector<double> CostFunction::hamming_costs(std::vector<std::vector<ClusterNode> > const &prunings,
+                                                AssignmentSolver &solver) {
+    std::vector<double> costs(prunings.size(), 0.0);
+    if (prunings.empty() || prunings[0].empty()) {
+        return costs;
+    }
+    size_t n_problems = prunings.size();
+    size_t rows = prunings[0].size();
+    size_t cols = prunings[0][0].counts.size();
+    std::vector<double> matrices(rows * cols * n_problems);
+    for (size_t p = 0; p < n_problems; p++) {
+        for (size_t r = 0; r < rows; r++) {
+            ClusterNode const &node = prunings[p][r];
+            int sum = std::accumulate(node.counts.begin(), node.counts.end(), 0);
+            for (size_t c = 0; c < cols; c++) {
+                matrices[(r * cols + c) * n_problems + p] = (double) (sum - node.counts[c]);
+            }
+        }
+    }
+    solver.solve_batch(matrices.data(), n_problems, rows, cols, costs.data());
+    return costs;
+}
+
+/*!
+ * Same structure-of-arrays layout as above, filled from the rows of the store's counts matrix.
+ */
+std::vector<double> CostFunction::hamming_costs(NodeStore const &store,
+                                                std::vector<std::vector<uint32_t> > const &prunings,
+                                                AssignmentSolver &solver) {
+    std::vector<double> costs(prunings.size(), 0.0);
+    if (prunings.empty() || prunings[0].empty()) {
+        return costs;
+    }
+    size_t n_problems = prunings.size();
+    size_t rows = prunings[0].size();
+    size_t cols = store.k;
+    std::vector<double> matrices(rows * cols * n_problems);
+    for (size_t p = 0; p < n_problems; p++) {
+        for (size_t r = 0; r < rows; r++) {
+            int const *counts = store.counts_of(prunings[p][r]);
+            int sum = std::accumulate(counts, counts + cols, 0);
+            for (size_t c = 0; c < cols; c++) {
+                matrices[(r * cols + c) * n_problems + p] = (double) (sum - counts[c]);
+            }
         }
-        cost_matrix.push_back(cur_cost);
     }
-    std::vector<int> assignment;
-    HungarianAlgorithm HungAlgo;
-    return HungAlgo.Solve(cost_matrix, assignment);
+    solver.solve_batch(matrices.data(), n_problems, rows, cols, costs.data());
+    return costs;
 }
@@ -1,7 +1,9 @@
 #ifndef CostFunction_h
 #define CostFunction_h
 
+#include "AssignmentSolver.h"
 #include "ClusterNode.h"
+#include "NodeStore.h"
 #include <vector>
 
 namespace CostFunction {
@@ -13,12 +15,49 @@ namespace CostFunction {
      */
     double majority_cost(ClusterNode const &node);
 
+    /**
+     * Calculates the majority cost of one node of a node store.
+     * @param store - the clustering tree
+     * @param node - index of the node
+     * @return majority cost of the node
+     */
+    double majority_cost(NodeStore const &store, uint32_t node);
+
     /**
      * Calculates the hamming cost based on all resulting cluster trees.
      * @param nodes - all root nodes containg  all clusters
      * @return hamming cost of optimal root node pruned into k clusters
      */
-    double hamming_cost(std::vector<ClusterNode> nodes);
+    double hamming_cost(std::vector<ClusterNode> const &nodes);
+
+    /**
+     * Calculates the hamming cost based on all resulting cluster trees, reusing the workspace of the given solver.
+     * @param nodes - all root nodes containg  all clusters
+     * @param solver - assignment solver whose workspace is reused between calls
+     * @return hamming cost of optimal root node pruned into k clusters
+     */
+    double hamming_cost(std::vector<ClusterNode> const &nodes, AssignmentSolver &solver);
+
+    /**
+     * Calculates the hamming costs of many prunings with the same number of clusters at once by handing all cost
+     * matrices to the batched assignment solver.
+     * @param prunings - all prunings, each given by its clusters
+     * @param solver - assignment solver whose workspace is reused between calls
+     * @return the hamming cost of each pruning
+     */
+    std::vector<double> hamming_costs(std::vector<std::vector<ClusterNode> > const &prunings,
+                                      AssignmentSolver &solver);
+
+    /**
+     * Calculates the hamming costs of many prunings of a node store at once, reading the label counts straight from
+     * the store's counts matrix.
+     * @param store - the clustering tree
+     * @param prunings - all prunings, each given by the indices of its clusters
+     * @param solver - assignment solver whose workspace is reused between calls
+     * @return the hamming cost of each pruning
+     */
+    std::vector<double> hamming_costs(NodeStore const &store, std::vector<std::vector<uint32_t> > const &prunings,
+                                      AssignmentSolver &solver);
 };
 
 #endif /* CostFunction_h */
@@ -0,0 +1,148 @@
+#ifndef CostPipeline_h
+#define CostPipeline_h
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AssignmentSolver.h"
+#include "ClusterNode.h"
+#include "NodeStore.h"
+
+/*!
+ * Scored leaf of the tree of executions, i.e. its interval together with the cost of its tree under every objective.
+ */
+struct LeafCosts {
+    double alpha_min;
+    double alpha_max;
+    bool exact;
+    std::vector<double> costs;
+};
+
+/*!
+ * Pipeline stage that scores the leaves of the tree of executions on a pool of cost workers while the exploration
+ * continues. The explorer pushes the root of each leaf's clustering tree, which is never changed after its merge, the
+ * workers flatten and score it and hand the results to the sink in the order in which the leaves were pushed. At most
+ * capacity leaves are in flight (queued, scored or waiting for an earlier leaf), push blocks until there is room, so
+ * the memory stays bounded however far the workers fall behind. Without workers every leaf is scored and sunk by push.
+ */
+class CostPipeline {
+public:
+    typedef std::function<std::vector<double>(NodeStore const &, AssignmentSolver &)> Score;
+    typedef std::function<void(LeafCosts const &)> Sink;
+
+    /**
+     * Starts the cost workers.
+     * @param workers - the number of cost workers, 0 scores on the calling thread
+     * @param capacity - the maximum number of leaves in flight
+     * @param score - calculates the costs of a flattened clustering tree, called by the workers
+     * @param sink - receives the scored leaves in the order in which they were pushed, one at a time
+     */
+    CostPipeline(size_t workers, size_t capacity, Score score, Sink sink)
+            : capacity(std::max<size_t>(1, capacity)), score(std::move(score)), sink(std::move(sink)), pushed(0),
+              next(0), done(false) {
+        for (size_t w = 0; w < workers; w++) {
+            threads.emplace_back([this]() { work(); });
+        }
+    }
+
+    ~CostPipeline() {
+        finish();
+    }
+
+    /**
+     * Adds a leaf, which blocks while capacity leaves are in flight.
+     * @param root - the root of the leaf's clustering tree
+     * @param alpha_min - start of the leaf's interval
+     * @param alpha_max - end of the leaf's interval
+     * @param exact - whether the leaf is certain
+     */
+    void push(ClusterNode const *root, double alpha_min, double alpha_max, bool exact) {
+        if (threads.empty()) {
+            sink(LeafCosts{alpha_min, alpha_max, exact, score(NodeStore::from_tree(*root), solver)});
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        room.wait(lock, [this]() { return pushed - next < capacity; });
+        queue.push_back(Item{pushed++, root, LeafCosts{alpha_min, alpha_max, exact, {}}});
+        work_ready.notify_one();
+    }
+
+    /**
+     * Waits until all pushed leaves are sunk, the workers keep running.
+     */
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex);
+        room.wait(lock, [this]() { return next == pushed; });
+    }
+
+    /**
+     * Waits until all pushed leaves are sunk and stops the workers.
+     */
+    void finish() {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done = true;
+        }
+        work_ready.notify_all();
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        threads.clear();
+    }
+
+private:
+    struct Item {
+        size_t sequence;
+        ClusterNode const *root;
+        LeafCosts leaf;
+    };
+
+    size_t capacity;
+    Score score;
+    Sink sink;
+    AssignmentSolver solver;
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable room;
+    std::deque<Item> queue;
+    /// scored leaves that wait for an earlier one, by their sequence number
+    std::map<size_t, LeafCosts> waiting;
+    size_t pushed;
+    size_t next;
+    bool done;
+
+    void work() {
+        AssignmentSolver worker_solver;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            work_ready.wait(lock, [this]() { return done || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+            Item item = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+            item.leaf.costs = score(NodeStore::from_tree(*item.root), worker_solver);
+            lock.lock();
+            waiting.emplace(item.sequence, std::move(item.leaf));
+
+            // the sink is called under the lock, so the leaves are sunk one at a time and in order
+            for (auto it = waiting.find(next); it != waiting.end(); it = waiting.find(next)) {
+                sink(it->second);
+                waiting.erase(it);
+                next++;
+            }
+            room.notify_one();
+        }
+    }
+};
+
+#endif /* CostPipeline_h */
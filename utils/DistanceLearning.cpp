@@ -34,17 +34,13 @@ ClusterNode *
 ClusterTree::convert_to_cluster_node(int k,
                                      std::vector<int> target_clusters) const {
   if (is_leaf) {
-    ClusterNode *node = new ClusterNode(nullptr, nullptr, vector<int>(), false);
-    for (int i = 0; i < k; i++)
-      node->counts.push_back(i == target_clusters[label] ? 1 : 0);
+    ClusterNode *node = new ClusterNode(nullptr, nullptr, LabelCounts(k), false);
+    node->counts[target_clusters[label]] = 1;
     return node;
   } else {
     ClusterNode *left_cn = left->convert_to_cluster_node(k, target_clusters);
     ClusterNode *right_cn = right->convert_to_cluster_node(k, target_clusters);
-    ClusterNode *node = new ClusterNode(left_cn, right_cn, vector<int>(), true);
-    for (int i = 0; i < k; i++)
-      node->counts.push_back(left_cn->counts[i] + right_cn->counts[i]);
-    return node;
+    return new ClusterNode(left_cn, right_cn);
   }
 }
 
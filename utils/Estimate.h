@@ -0,0 +1,187 @@
+#ifndef Estimate_h
+#define Estimate_h
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ClusterNode.h"
+#include "LinkageOptions.h"
+#include "Objective.h"
+
+#include "Clustering.h"
+#include "Parallel.h"
+#include "Prune.h"
+#include "Spill.h"
+
+namespace Estimate {
+
+    /// seed of all random choices, which keeps the estimates of repeated runs identical
+    const unsigned int seed = 0;
+
+    /*!
+     * Estimated size of the tree of executions of one sweep, each value the mean over all probes (with its standard
+     * error where it matters for scheduling), and the resources that a sweep of it would need.
+     */
+    struct TreeSize {
+        size_t probes;
+        double leaves;
+        double leaves_error;
+        double steps;
+        double merges;
+        double seconds;
+        double seconds_error;
+        /// the most states that were pending at once on any probed path
+        size_t peak_states;
+        size_t state_bytes;
+        size_t peak_bytes;
+
+        /**
+         * Formats the estimate as one JSON object.
+         * @param file - the input file of the sweep
+         * @return the JSON object in one line
+         */
+        std::string json(std::string const &file) const {
+            std::ostringstream out;
+            out << "{\"file\": \"";
+            for (char c : file) {
+                out << (c == '"' || c == '\\' ? "\\" : "") << c;
+            }
+            out << "\", \"probes\": " << probes << ", \"leaves\": " << leaves
+                << ", \"leaves_error\": " << leaves_error << ", \"steps\": " << steps << ", \"merges\": " << merges
+                << ", \"seconds\": " << seconds << ", \"seconds_error\": " << seconds_error << ", \"peak_states\": "
+                << peak_states << ", \"state_bytes\": " << state_bytes << ", \"peak_bytes\": " << peak_bytes << "}";
+            return out.str();
+        }
+    };
+
+    /**
+     * Estimates the size of the tree of executions by Knuth's random probes: every probe descends from the initial
+     * state along one path of the tree, choosing a uniformly random child at each split, like a sweep expands its
+     * states. Each step counts as often as the product of the numbers of children on the path above it, which makes
+     * the sums of a probe unbiased estimates of the number of steps, merges and leaves of the whole tree, and the
+     * timed steps and the scoring of the leaf an estimate of its runtime. The peak memory is taken from the widest
+     * probed path, where all siblings of a depth first sweep are pending, together with the nodes of all merges.
+     * @param initial - the initial state
+     * @param probes - the number of probes
+     * @param use_majority - use majority cost instead of hamming cost
+     * @param maxlabel - the highest class number
+     * @param options - tuning options of the linkage
+     * @return the mean of all probes
+     */
+    template<typename S>
+    TreeSize probe(S const &initial, size_t probes, bool use_majority, unsigned long maxlabel,
+                   const LinkageOptions &options) {
+        std::vector<Objective> objectives = options.objectives;
+        if (objectives.empty()) {
+            objectives.emplace_back(use_majority, maxlabel);
+        }
+        std::mt19937_64 random(seed);
+        AssignmentSolver solver;
+        TreeSize size{probes, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1, Spill::bytes(initial), 0};
+        double leaves_squares = 0.0;
+        double seconds_squares = 0.0;
+        for (size_t p = 0; p < probes; p++) {
+            std::vector<S> path(1, initial);
+            double weight = 1.0;
+            double steps = 0.0;
+            double merges = 0.0;
+            double seconds = 0.0;
+            size_t pending = 1;
+            while (path[0].active_indices.size() > 1) {
+                size_t active = path[0].active_indices.size();
+                auto start = std::chrono::steady_clock::now();
+                size_t children = Clustering::expand(path, 0, options);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+                // the step is made by every state at this depth, its children by their weight times as many
+                steps += weight;
+                seconds += weight * elapsed.count();
+                weight *= (double) children;
+                pending += children - 1;
+                size_t child = std::uniform_int_distribution<size_t>(0, children - 1)(random);
+                if (child > 0) {
+                    path[0] = std::move(path[child]);
+                }
+                path.resize(1);
+                merges += weight * (double) (active - path[0].active_indices.size());
+            }
+            auto start = std::chrono::steady_clock::now();
+            objective_costs(NodeStore::from_tree(*path[0].nodes[path[0].active_indices[0]]), objectives, solver);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            seconds += weight * elapsed.count();
+
+            size.leaves += weight;
+            leaves_squares += weight * weight;
+            size.steps += steps;
+            size.merges += merges;
+            size.seconds += seconds;
+            seconds_squares += seconds * seconds;
+            size.peak_states = std::max(size.peak_states, pending);
+        }
+        auto count = (double) std::max<size_t>(1, probes);
+        size.leaves /= count;
+        size.steps /= count;
+        size.merges /= count;
+        size.seconds /= count;
+        size.leaves_error = std::sqrt(std::max(0.0, leaves_squares / count - size.leaves * size.leaves) / count);
+        size.seconds_error = std::sqrt(std::max(0.0, seconds_squares / count - size.seconds * size.seconds) / count);
+        size.peak_bytes = size.peak_states * size.state_bytes + (size_t) size.merges * sizeof(ClusterNode);
+        return size;
+    }
+
+    /// number of explored states per shard, the more states the better the shards can be balanced
+    const size_t shard_states = 64;
+
+    /// number of probes that estimate the subtree below each explored state of the shard planning
+    const size_t shard_probes = 8;
+
+    /**
+     * Splits the interval of a run into shards for separate processes. The top of the tree of executions is explored
+     * until there are shard_states states per shard, the size of the subtree below each of them is estimated by
+     * shard_probes probes, i.e. its steps and leaves, and their intervals are then grouped into contiguous shards
+     * with about the same estimated size. The explored states are probed in parallel, one thread each.
+     * @param states - a vector of states containing the input state
+     * @param shards - the number of shards
+     * @param use_majority - use majority cost instead of hamming cost
+     * @param maxlabel - the highest class number
+     * @param options - tuning options of the linkage
+     * @return the intervals [alpha_min, alpha_max] of the shards in ascending order, which tile the input interval
+     */
+    template<typename S>
+    std::vector<std::pair<double, double> > getshards(std::vector<S> states, size_t shards, bool use_majority,
+                                                      unsigned long maxlabel, const LinkageOptions &options) {
+        Clustering::explore(states, shards * shard_states, options);
+        std::vector<double> sizes(states.size());
+        size_t threads = std::max<size_t>(1, std::min(options.threads, states.size()));
+        LinkageOptions single = options;
+        single.threads = 1;
+        Parallel::run_chunks(threads, [&](size_t c) {
+            for (size_t index = c; index < states.size(); index += threads) {
+                TreeSize size = probe(states[index], shard_probes, use_majority, maxlabel, single);
+                sizes[index] = size.steps + size.leaves;
+            }
+        });
+        double total = 0.0;
+        for (double size : sizes) {
+            total += size;
+        }
+        std::vector<std::pair<double, double> > intervals;
+        double done = 0.0;
+        for (size_t index = 0; index < states.size(); index++) {
+            if (intervals.empty() || (intervals.size() < shards &&
+                                      done >= total * (double) intervals.size() / (double) shards)) {
+                intervals.emplace_back(states[index].alpha_min, states[index].alpha_max);
+            }
+            intervals.back().second = states[index].alpha_max;
+            done += sizes[index];
+        }
+        return intervals;
+    }
+}
+
+#endif /* Estimate_h */
@@ -1,19 +1,31 @@
 #include "Evaluation.h"
 
+#include <algorithm>
+#include <cmath>
+#include <deque>
 #include <dirent.h>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <vector>
 
+#include "AssignmentSolver.h"
+#include "ExecutionTree.h"
 #include "Helpers.h"
+#include "Parallel.h"
+#include "Prune.h"
+
+/// number of leaves of a tree of executions that are read and scored together per thread
+const size_t evaluate_batch_leaves = 64;
 
 /*!
  * Combine a vector of AlphaRanges (that can be unstructured and include the same ranges multiple times) to unique
  * ranges with averaged costs.
  */
-std::vector<AlphaRange> Evaluation::average_costs(std::vector<AlphaRange> const &costs, double amount) {
+std::vector<AlphaRange> Evaluation::average_costs(std::vector<AlphaRange> const &costs, double amount, double alpha_min,
+                                                  double alpha_max) {
     std::vector<AlphaRange> out_costs;
-    out_costs.emplace_back(0.0, 1.0, 0.0);
+    out_costs.emplace_back(alpha_min, alpha_max, 0.0);
     for (AlphaRange in : costs) {
         in.cost /= amount;
         std::vector<AlphaRange> temp(out_costs);
@@ -62,6 +74,165 @@ std::vector<AlphaRange> Evaluation::compress_regions(std::vector<AlphaRange> con
     return out_ranges;
 }
 
+/*!
+ * Both landscapes are walked at once, every overlap of two ranges contributes its length times the cost difference.
+ */
+double Evaluation::landscape_error(std::vector<AlphaRange> const &ranges1, std::vector<AlphaRange> const &ranges2) {
+    double error = 0.0;
+    size_t i = 0, j = 0;
+    while (i < ranges1.size() && j < ranges2.size()) {
+        double overlap = std::min(ranges1[i].max, ranges2[j].max) - std::max(ranges1[i].min, ranges2[j].min);
+        if (overlap > 0) {
+            error += overlap * std::abs(ranges1[i].cost - ranges2[j].cost);
+        }
+        if (ranges1[i].max < ranges2[j].max) {
+            i++;
+        } else {
+            j++;
+        }
+    }
+    return error;
+}
+
+/*!
+ * Collects the ranges of all shards and sorts them by alpha. Every shard ends where the next one starts, since the
+ * shards are written with the same precision as their boundaries. A range that starts at a shard boundary can be
+ * narrower than this precision and is read back with zero width, such ranges are dropped instead of stitched.
+ */
+bool Evaluation::merge_shards(std::vector<std::string> const &files, std::string const &output_file) {
+    std::vector<AlphaRange> ranges;
+    for (const std::string &path : files) {
+        std::vector<AlphaRange> shard = get_ranges("", path);
+        if (shard.empty()) {
+            std::cerr << "Warning: shard " << path << " contains no ranges." << std::endl;
+        }
+        for (AlphaRange const &range : shard) {
+            if (range.min < range.max) {
+                ranges.push_back(range);
+            }
+        }
+    }
+    std::sort(ranges.begin(), ranges.end(), Helpers::compareByAlphaMin);
+    bool tiled = true;
+    for (size_t i = 1; i < ranges.size(); i++) {
+        if (ranges[i].min != ranges[i - 1].max) {
+            std::cerr << "Warning: the shards " << (ranges[i].min > ranges[i - 1].max ? "leave a gap" : "overlap")
+                      << " between " << ranges[i - 1].max << " and " << ranges[i].min << "." << std::endl;
+            tiled = false;
+        }
+    }
+    std::ofstream file;
+    file.open(output_file);
+    for (AlphaRange const &out : ranges) {
+        file << out.min << "," << out.max << "," << out.cost << "\n";
+    }
+    if (!ranges.empty()) {
+        std::cout << "Merged " << files.size() << " shards to " << ranges.size() << " ranges in ["
+                  << ranges.front().min << "," << ranges.back().max << "]" << std::endl;
+    }
+    return tiled;
+}
+
+/*!
+ * Every leaf replays its merges on top of the shared initial clusters, whose nodes are only read, so each leaf only
+ * allocates the nodes of its own merges.
+ */
+std::vector<std::vector<AlphaRange> > Evaluation::evaluate_tree(std::string const &tree_file,
+                                                                std::vector<Objective> const &objectives,
+                                                                size_t threads) {
+    std::vector<std::vector<AlphaRange> > ranges(objectives.size());
+    ExecutionTreeReader reader;
+    if (!reader.open(tree_file) || reader.clusters.empty()) {
+        std::cerr << "Warning: " << tree_file << " is no tree of executions." << std::endl;
+        return ranges;
+    }
+    std::deque<ClusterNode> initial_pool;
+    std::vector<ClusterNode *> initial;
+    for (NodeStore const &cluster : reader.clusters) {
+        initial.push_back(cluster.to_tree(initial_pool));
+    }
+    threads = std::max<size_t>(1, threads);
+
+    struct Leaf {
+        double alpha_min;
+        double alpha_max;
+        std::vector<std::pair<long, long> > merges;
+        std::vector<double> costs;
+    };
+    std::vector<Leaf> batch(threads * evaluate_batch_leaves);
+    bool more = true;
+    while (more) {
+        size_t count = 0;
+        while (count < batch.size() && (more = reader.next(batch[count].alpha_min, batch[count].alpha_max,
+                                                           batch[count].merges))) {
+            count++;
+        }
+        Parallel::run_chunks(std::min(threads, count), [&](size_t c) {
+            AssignmentSolver solver;
+            for (size_t l = c; l < count; l += threads) {
+                std::deque<ClusterNode> pool;
+                std::vector<ClusterNode *> nodes(initial);
+                long root = 0;
+                for (std::pair<long, long> const &merge : batch[l].merges) {
+                    pool.emplace_back(nodes[merge.first], nodes[merge.second]);
+                    nodes[merge.first] = &pool.back();
+                    root = merge.first;
+                }
+                NodeStore store = NodeStore::from_tree(*nodes[root]);
+                batch[l].costs = objective_costs(store, objectives, solver);
+                for (double &cost : batch[l].costs) {
+                    cost /= (double) store.leaf_count(0);
+                }
+            }
+        });
+        for (size_t l = 0; l < count; l++) {
+            for (size_t o = 0; o < objectives.size(); o++) {
+                ranges[o].emplace_back(batch[l].alpha_min, batch[l].alpha_max, batch[l].costs[o]);
+            }
+        }
+    }
+    return ranges;
+}
+
+/*!
+ * Like a linkage run, a single tree is written as it is and several trees are averaged if wanted.
+ */
+void Evaluation::evaluate_trees(std::vector<std::string> const &files, std::string const &output_file, bool verbose,
+                                bool average, std::vector<Objective> const &objectives, size_t threads) {
+    std::vector<std::vector<AlphaRange> > ranges(objectives.size());
+    for (std::string const &file : files) {
+        std::cout << "Evaluating " << file << std::endl;
+        std::vector<std::vector<AlphaRange> > tree_ranges = evaluate_tree(file, objectives, threads);
+        for (size_t i = 0; verbose && !tree_ranges.empty() && i < tree_ranges[0].size(); i++) {
+            std::cout << tree_ranges[0][i].min << "," << tree_ranges[0][i].max;
+            for (std::vector<AlphaRange> const &column : tree_ranges) {
+                std::cout << "," << column[i].cost;
+            }
+            std::cout << std::endl;
+        }
+        for (size_t o = 0; o < objectives.size(); o++) {
+            ranges[o].insert(ranges[o].end(), tree_ranges[o].begin(), tree_ranges[o].end());
+        }
+    }
+    if (average) {
+        for (std::vector<AlphaRange> &column : ranges) {
+            column = average_costs(column, (double) files.size());
+            std::sort(column.begin(), column.end(), Helpers::compareByAlphaMin);
+        }
+    }
+    if (!output_file.empty()) {
+        std::ofstream file;
+        file.open(output_file);
+        for (size_t i = 0; i < ranges[0].size(); i++) {
+            file << ranges[0][i].min << "," << ranges[0][i].max;
+            for (std::vector<AlphaRange> const &column : ranges) {
+                file << "," << column[i].cost;
+            }
+            file << "\n";
+        }
+    }
+}
+
 /*!
  *  Evaluate all experiment results in one folder with the given ending and stores the result that is averaged over all
  *  files in the given output path
@@ -6,16 +6,20 @@
 #include <vector>
 
 #include "../types/AlphaRange.h"
+#include "../types/Objective.h"
 
 namespace Evaluation {
 
     /**
-     * Combines all ranges to unique intervals in range [0,1] and averages costs for each interval.
+     * Combines all ranges to unique intervals in range [alpha_min,alpha_max] and averages costs for each interval.
      * @param costs - all input ranges
      * @param amount - number indicating how many experiments are included in the costs vectors.
-     * @return averaged costs in [0,1]
+     * @param alpha_min - start of the swept interval (default 0)
+     * @param alpha_max - end of the swept interval (default 1)
+     * @return averaged costs in [alpha_min,alpha_max]
      */
-    std::vector<AlphaRange> average_costs(std::vector<AlphaRange> const &costs, double amount);
+    std::vector<AlphaRange> average_costs(std::vector<AlphaRange> const &costs, double amount, double alpha_min = 0.0,
+                                          double alpha_max = 1.0);
 
     /**
      * Compressed a vector of intervals by concatenating following intervals with same cost.
@@ -24,6 +28,48 @@ namespace Evaluation {
      */
     std::vector<AlphaRange> compress_regions(std::vector<AlphaRange> const &ranges);
 
+    /**
+     * Calculates the mean absolute difference of two cost landscapes over alpha in [0,1].
+     * @param ranges1 - the first landscape, sorted by alpha
+     * @param ranges2 - the second landscape, sorted by alpha
+     * @return the integral of the absolute cost difference over alpha
+     */
+    double landscape_error(std::vector<AlphaRange> const &ranges1, std::vector<AlphaRange> const &ranges2);
+
+    /**
+     * Stitches the results of runs on adjacent alpha intervals (shards) to one result and exports it to given file.
+     * Gaps or overlaps between the shards are reported, ranges of zero width are dropped.
+     * @param files - the result files of all shards, in any order
+     * @param output_file - output file
+     * @return if the shards tile one interval without gaps or overlaps
+     */
+    bool merge_shards(std::vector<std::string> const &files, std::string const &output_file);
+
+    /**
+     * Scores every leaf of a tree of executions that was written by a linkage run, without running the linkage again.
+     * The leaves are read in batches whose clustering trees are rebuilt and scored in parallel.
+     * @param tree_file - the file of the tree of executions
+     * @param objectives - the cost functions and amounts of target clusters, k = 0 uses the number of labels
+     * @param threads - the number of threads
+     * @return for every objective the interval and cost of every leaf in the order of alpha, empty if the file cannot
+     * be read
+     */
+    std::vector<std::vector<AlphaRange> > evaluate_tree(std::string const &tree_file,
+                                                        std::vector<Objective> const &objectives, size_t threads);
+
+    /**
+     * Scores the trees of executions of several runs and exports their ranges or their average to given file, with
+     * one cost column per objective.
+     * @param files - the files of the trees of executions
+     * @param output_file - output file
+     * @param verbose - output the ranges to the console
+     * @param average - average the costs over all trees
+     * @param objectives - the cost functions and amounts of target clusters, k = 0 uses the number of labels
+     * @param threads - the number of threads
+     */
+    void evaluate_trees(std::vector<std::string> const &files, std::string const &output_file, bool verbose,
+                        bool average, std::vector<Objective> const &objectives, size_t threads);
+
     /**
      * Average all files in a given folder and export to given file.
      * @param input_folder - input directory
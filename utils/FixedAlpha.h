@@ -0,0 +1,195 @@
+#ifndef FixedAlpha_h
+#define FixedAlpha_h
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "AlphaRange.h"
+#include "LinkageOptions.h"
+#include "State.h"
+
+#include "Merge.h"
+#include "Parallel.h"
+#include "Prune.h"
+
+namespace FixedAlpha {
+
+    /**
+     * Finds the nearest active cluster of a cluster at a fixed alpha, ordered like the merges of the sweep (distance,
+     * slope, pair) so that ties between equally near clusters are broken the same way.
+     * @param st - the state
+     * @param i - the cluster
+     * @param alpha - the value of alpha
+     * @return the pair of the cluster and its nearest cluster
+     */
+    inline BestMerge nearest(State const &st, long i, double alpha) {
+        BestMerge best;
+        for (long k : st.active_indices) {
+            if (k == i) {
+                continue;
+            }
+            long cluster1 = std::min(i, k), cluster2 = std::max(i, k);
+            InterpolatedDistance const &f = st.dists[st.layout.row_base(cluster1) + cluster2];
+            double d = f.at(alpha);
+            if (best.improves(d, f.slope(), cluster1, cluster2)) {
+                best.dist = d;
+                best.lf = f.function();
+                best.indices = MergeCandidate(cluster1, cluster2);
+            }
+        }
+        return best;
+    }
+
+    /**
+     * Clusters a state at a fixed alpha by caching the nearest neighbour of every cluster. Every step merges the pair
+     * that the sweep would merge at this alpha, i.e. the smallest pair by distance, slope and indices. A nearest
+     * neighbour chain would need fewer scans for reducible linkages but merges the first mutual pair it reaches, which
+     * breaks ties differently. After a merge only the merged cluster and the clusters whose cached neighbour was merged
+     * are rescanned, all others only compare their cache with the merged cluster.
+     * @param st - the state, receives the merged clusters
+     * @param alpha - the value of alpha
+     * @param threads - the maximum number of threads for the distance updates
+     * @param created - receives all nodes created by the merges
+     */
+    template<typename S>
+    void nn_cache(S &st, double alpha, size_t threads, std::vector<ClusterNode *> &created) {
+        std::vector<BestMerge> neighbour(st.nodes.size());
+        for (long k : st.active_indices) {
+            neighbour[k] = nearest(st, k, alpha);
+        }
+        while (st.active_indices.size() > 1) {
+            BestMerge best;
+            for (long k : st.active_indices) {
+                best.offer(neighbour[k]);
+            }
+            long i = best.indices.cluster1, j = best.indices.cluster2;
+            merge_clusters(st, i, j, threads);
+            created.push_back(st.nodes[i]);
+            neighbour[i] = nearest(st, i, alpha);
+            for (long k : st.active_indices) {
+                if (k == i) {
+                    continue;
+                }
+                MergeCandidate const &cached = neighbour[k].indices;
+                if (cached.cluster1 == i || cached.cluster2 == i || cached.cluster1 == j || cached.cluster2 == j) {
+                    neighbour[k] = nearest(st, k, alpha);
+                } else {
+                    long cluster1 = std::min(i, k), cluster2 = std::max(i, k);
+                    InterpolatedDistance const &f = st.dists[st.layout.row_base(cluster1) + cluster2];
+                    double d = f.at(alpha);
+                    if (neighbour[k].improves(d, f.slope(), cluster1, cluster2)) {
+                        neighbour[k].dist = d;
+                        neighbour[k].lf = f.function();
+                        neighbour[k].indices = MergeCandidate(cluster1, cluster2);
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Clusters a copy of the initial state at one fixed alpha and scores the resulting tree.
+     * @param state - the initial state
+     * @param alpha - the value of alpha
+     * @param objectives - the cost functions and amounts of target clusters, k = 0 uses the number of labels
+     * @param solver - assignment solver whose workspace is reused between calls
+     * @return the (not normalized) cost of the tree under each objective
+     */
+    template<typename S>
+    std::vector<double> cost_at(S const &state, double alpha, std::vector<Objective> const &objectives,
+                                AssignmentSolver &solver) {
+        S st = state;
+        st.alpha_min = alpha;
+        st.alpha_max = alpha;
+        std::vector<ClusterNode *> created;
+        nn_cache(st, alpha, 1, created);
+        std::vector<double> costs = objective_costs(NodeStore::from_tree(*st.nodes[st.active_indices[0]]),
+                                                    objectives, solver);
+        for (ClusterNode *node : created) {
+            delete node;
+        }
+        return costs;
+    }
+
+    /**
+     * Approximates the ranges of a sweep on a grid: [alpha_start, alpha_end] is split into options.alpha_grid equal
+     * cells, each clustered at its centre. The cells are evaluated in parallel, each thread on its own copy of the
+     * state, so the memory grows with the number of threads instead of the number of cells. A grid of one cell on an
+     * empty interval clusters at exactly one alpha.
+     * @param state - the initial state
+     * @param output_file - the file the ranges are written into
+     * @param labels_size - the amount of different classes
+     * @param maxlabel - the highest class number
+     * @param verbose - output directly to console
+     * @param average - calculate average over multiple files
+     * @param use_majority - use majority cost instead of hamming cost
+     * @param options - the interval, grid and objectives
+     * @return for every objective the cost of every cell in the order of alpha
+     */
+    template<typename S, typename std::enable_if<std::is_base_of<State, S>::value, int>::type = 0>
+    std::vector<std::vector<AlphaRange> >
+    getgridranges(S const &state, std::string const &output_file, unsigned long labels_size, unsigned long maxlabel,
+                  bool verbose, bool average, bool use_majority, const LinkageOptions &options) {
+        std::vector<Objective> objectives = options.objectives;
+        if (objectives.empty()) {
+            objectives.emplace_back(use_majority, maxlabel);
+        }
+        size_t cells = options.alpha_grid;
+        double width = (options.alpha_end - options.alpha_start) / (double) cells;
+        std::vector<std::vector<double> > costs(cells);
+        size_t threads = std::max<size_t>(1, std::min(options.threads, cells));
+        Parallel::run_chunks(threads, [&](size_t c) {
+            AssignmentSolver solver;
+            for (size_t cell = c; cell < cells; cell += threads) {
+                costs[cell] = cost_at(state, options.alpha_start + ((double) cell + 0.5) * width, objectives, solver);
+            }
+        });
+
+        std::vector<std::vector<AlphaRange> > columns(objectives.size());
+        std::ofstream myfile;
+        if (!average && !output_file.empty()) {
+            myfile.open(output_file);
+        }
+        for (size_t cell = 0; cell < cells; cell++) {
+            double min = options.alpha_start + (double) cell * width;
+            double max = cell + 1 == cells ? options.alpha_end : min + width;
+            for (size_t o = 0; o < objectives.size(); o++) {
+                columns[o].emplace_back(min, max, costs[cell][o] / (double) labels_size);
+            }
+            if (myfile.is_open()) {
+                myfile << min << "," << max;
+                for (std::vector<AlphaRange> const &column : columns) {
+                    myfile << "," << column.back().cost;
+                }
+                myfile << "\n";
+            }
+            if (verbose) {
+                std::cout << min << "," << max;
+                for (std::vector<AlphaRange> const &column : columns) {
+                    std::cout << "," << column.back().cost;
+                }
+                std::cout << std::endl;
+            }
+        }
+        return columns;
+    }
+
+    /**
+     * States that do not know all distances cannot be clustered at a fixed alpha.
+     * @return no ranges
+     */
+    template<typename S, typename std::enable_if<!std::is_base_of<State, S>::value, int>::type = 0>
+    std::vector<std::vector<AlphaRange> >
+    getgridranges(S const &state, std::string const &output_file, unsigned long labels_size, unsigned long maxlabel,
+                  bool verbose, bool average, bool use_majority, const LinkageOptions &options) {
+        std::cerr << "Fixed values of alpha need all distances." << std::endl;
+        return std::vector<std::vector<AlphaRange> >(std::max<size_t>(1, options.objectives.size()));
+    }
+}
+
+#endif /* FixedAlpha_h */
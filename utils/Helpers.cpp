@@ -4,6 +4,8 @@
 
 #include "Helpers.h"
 
+#include <unistd.h>
+
 /*!
  * Check if the minimum alpha value if a range is smaller than the one of another range in order to sort AlphaRanges.
  */
@@ -30,6 +32,18 @@ long Helpers::get_reduced_matrix_outter_index(unsigned long width, long i) {
     return (width * (width - 1)) / 2 - ((width - i) * (width - i - 1)) / 2 - i - 1;
 }
 
+/*!
+ * Queries the available physical pages from the operating system.
+ */
+size_t Helpers::available_memory() {
+    long pages = sysconf(_SC_AVPHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (pages <= 0 || page_size <= 0) {
+        return 0;
+    }
+    return (size_t) pages * (size_t) page_size;
+}
+
 void Helpers::load_data(std::vector<std::vector<double> > const &data, std::vector<double> &labels,
                         std::vector<std::vector<double> > &feature_vectors, const std::vector<double> &sublabels,
                         int points_per_label, int batch_id) {
@@ -45,6 +45,12 @@ namespace Helpers {
      */
     long get_reduced_matrix_outter_index(unsigned long width, long i);
 
+    /**
+     * Gets the amount of physical memory that is currently available.
+     * @return available memory in bytes
+     */
+    size_t available_memory();
+
     /**
      * Gets all unique values in a vector.
      * @tparam T - feature type.
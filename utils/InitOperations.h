@@ -1,30 +1,313 @@
 #ifndef InitOperations_h
 #define InitOperations_h
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+#include "Coreset.h"
 #include "DistanceFunction.h"
+#include "DistanceLayout.h"
+#include "DistanceReader.h"
 #include "Helpers.h"
+#include "LinkageOptions.h"
+#include "Metrics.h"
+#include "Parallel.h"
+#include "SparseState.h"
 #include "State.h"
 
+/// smallest number of points for which the square layout is chosen automatically, below it the cheaper copies of the
+/// condensed layout for every split state outweigh the faster merge updates
+const size_t square_layout_min_points = 512;
+
+/// the square layout is only chosen automatically if the distance matrix of a state uses at most this share of memory
+const double square_layout_memory_share = 1.0 / 16;
+
+/**
+ * Chooses the distance layout for a given number of points. LAYOUT_AUTO picks the square layout for mid-sized inputs,
+ * i.e. from square_layout_min_points on as long as the square distance matrix of a state fits into
+ * square_layout_memory_share of the available memory, and the condensed layout otherwise.
+ * @param len - the amount of feature vectors
+ * @param mode - the requested layout mode
+ * @return the distance layout
+ */
+inline DistanceLayout choose_layout(size_t len, LayoutMode mode) {
+    if (mode == LAYOUT_SQUARE) {
+        return DistanceLayout::square(len);
+    }
+    if (mode == LAYOUT_AUTO && len >= square_layout_min_points) {
+        DistanceLayout square = DistanceLayout::square(len);
+        double square_bytes = (double) square.entries() * sizeof(InterpolatedDistance);
+        if (square_bytes <= square_layout_memory_share * (double) Helpers::available_memory()) {
+            return square;
+        }
+    }
+    return DistanceLayout::condensed(len);
+}
+
+/**
+ * Groups identical feature vectors. Rows are bucketed by a hash of their values and compared exactly within a bucket,
+ * so that every group holds the indices of one distinct point in ascending order. The groups are ordered by their
+ * first index, which keeps the relative order of the points (and with it every tie-break by cluster index) unchanged.
+ * @tparam T - the numeric feature type
+ * @param feature_vectors - a vector of all feature vectors (i.e. points)
+ * @param collapse - whether identical points are grouped at all, otherwise every point forms its own group
+ * @return the groups of identical points
+ */
+template<typename T>
+std::vector<std::vector<size_t> > getduplicategroups(const std::vector<std::vector<T> > &feature_vectors,
+                                                     bool collapse) {
+    std::vector<std::vector<size_t> > groups;
+    groups.reserve(feature_vectors.size());
+    std::unordered_map<size_t, std::vector<size_t> > buckets;
+    for (size_t i = 0; i < feature_vectors.size(); i++) {
+        if (collapse) {
+            size_t hash = feature_vectors[i].size();
+            for (T const &value : feature_vectors[i]) {
+                // -0.0 == 0.0, so both have to land in the same bucket
+                hash ^= std::hash<T>()(value == 0 ? T(0) : value) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+            }
+            std::vector<size_t> &bucket = buckets[hash];
+            auto same = std::find_if(bucket.begin(), bucket.end(), [&](size_t group) {
+                return feature_vectors[groups[group][0]] == feature_vectors[i];
+            });
+            if (same != bucket.end()) {
+                groups[*same].push_back(i);
+                continue;
+            }
+            bucket.push_back(groups.size());
+        }
+        groups.emplace_back(1, i);
+    }
+    return groups;
+}
+
+/**
+ * Get one feature vector of each group of identical points.
+ * @tparam T - the numeric feature type
+ * @param feature_vectors - a vector of all feature vectors (i.e. points)
+ * @param groups - the groups of identical points
+ * @return the feature vectors of the distinct points
+ */
+template<typename T>
+std::vector<std::vector<T> > getrepresentatives(const std::vector<std::vector<T> > &feature_vectors,
+                                                const std::vector<std::vector<size_t> > &groups) {
+    std::vector<std::vector<T> > representatives;
+    representatives.reserve(groups.size());
+    for (std::vector<size_t> const &group : groups) {
+        representatives.push_back(feature_vectors[group[0]]);
+    }
+    return representatives;
+}
+
+/**
+ * Groups the points into the initial clusters, which are either the micro-clusters of a coreset of
+ * options.coreset_size weighted representatives or the groups of identical points.
+ * @tparam T - the numeric feature type
+ * @param feature_vectors - a vector of all feature vectors (i.e. points)
+ * @param options - the size of the coreset and whether identical points are grouped
+ * @param representatives - receives the feature vector of each group
+ * @return the points of each group in ascending order, ordered by their first point
+ */
+template<typename T>
+std::vector<std::vector<size_t> > getpointgroups(const std::vector<std::vector<T> > &feature_vectors,
+                                                 LinkageOptions const &options,
+                                                 std::vector<std::vector<T> > &representatives) {
+    std::vector<std::vector<size_t> > groups;
+    if (options.coreset_size > 0 && options.coreset_size < feature_vectors.size()) {
+        Coreset::getgroups(feature_vectors, options.coreset_size, options.threads, groups, representatives);
+    } else {
+        groups = getduplicategroups(feature_vectors, options.collapse_duplicates);
+        representatives = getrepresentatives(feature_vectors, groups);
+    }
+    return groups;
+}
+
 /**
   * Get the initial distances between all points - each point describes a cluster.
-   * The vector is represented as a flattened n x n matrix with the clusterwise distances between i and j in n where
-   * all redundant values are cancelled out.
+  * In the condensed layout the vector is represented as a flattened n x n matrix with the clusterwise distances between
+  * i and j in n where all redundant values are cancelled out, in the square layout as full padded n x n matrix.
+  * The rows are computed in tiles by the kernels of the metric, spread over the given threads. Throws an
+  * invalid_argument if a distance is NaN (e.g. for NaN features).
+ * @tparam M - the metric policy
  * @tparam T - the numeric feature type
  * @param feature_vectors - a vector of all feature vectors (i.e. points)
- * @param len - the amount of feature vectors
- * @return euclidean distances between all points
+ * @param layout - the layout of the returned distances
+ * @param threads - the number of threads that compute the rows
+ * @return the distances between all points under the metric as constant functions of alpha
+ */
+template<typename M, typename T>
+DistanceFunctions getdists(const std::vector<std::vector<T> > &feature_vectors, DistanceLayout const &layout,
+                           size_t threads) {
+    Metrics::PackedPoints points = Metrics::pack<M>(feature_vectors);
+    DistanceFunctions dists(layout.entries(), InterpolatedDistance(0.0, 0.0));
+    size_t len = layout.width;
+    threads = std::max<size_t>(1, std::min(threads, (len + Metrics::tile_rows - 1) / Metrics::tile_rows));
+    std::vector<char> undefined(threads, 0);
+    Parallel::run_chunks(threads, [&](size_t c) {
+        std::vector<double> tile(Metrics::tile_rows * points.stride);
+        // rows get shorter towards the end, so every thread takes every threads-th tile of rows
+        for (size_t first = c * Metrics::tile_rows; first < len; first += threads * Metrics::tile_rows) {
+            size_t rows = std::min(Metrics::tile_rows, len - first);
+            Metrics::row_dists<M>(points, first, rows, tile.data());
+            for (size_t i = first; i < first + rows; i++) {
+                double const *row = &tile[(i - first) * points.stride];
+                long base = layout.row_base((long) i);
+                for (size_t j = i + 1; j < len; j++) {
+                    undefined[c] |= std::isnan(row[j]);
+                    dists[base + j] = InterpolatedDistance(row[j], row[j]);
+                    if (layout.is_square()) {
+                        dists[j * layout.stride + i] = dists[base + j];
+                    }
+                }
+            }
+        }
+    });
+    // the merge scans cannot order NaN distances
+    if (std::find(undefined.begin(), undefined.end(), 1) != undefined.end()) {
+        std::__throw_invalid_argument("The feature vectors have undefined distances.");
+    }
+    return dists;
+}
+
+/**
+ * Get the initial distances between all points under the metric of the options.
+ * @tparam T - the numeric feature type
+ * @param feature_vectors - a vector of all feature vectors (i.e. points)
+ * @param layout - the layout of the returned distances
+ * @param options - the metric and the number of threads
+ * @return the distances between all points as constant functions of alpha
  */
 template<typename T>
-std::vector<double> getdists(const std::vector<std::vector<T> > &feature_vectors, size_t len) {
-    std::vector<double> dists;
-    for (auto i = 0; i < len; i = i + 1) {
-        for (auto j = i + 1; j < len; j = j + 1) {
-            dists.push_back(DistanceFunction::euclidean_dist(feature_vectors[i], feature_vectors[j]));
+DistanceFunctions getdists(const std::vector<std::vector<T> > &feature_vectors, DistanceLayout const &layout,
+                           LinkageOptions const &options) {
+    switch (options.metric) {
+        case METRIC_SQEUCLIDEAN:
+            return getdists<Metrics::SquaredEuclidean>(feature_vectors, layout, options.threads);
+        case METRIC_COSINE:
+            return getdists<Metrics::Cosine>(feature_vectors, layout, options.threads);
+        case METRIC_MANHATTAN:
+            return getdists<Metrics::Manhattan>(feature_vectors, layout, options.threads);
+        default:
+            return getdists<Metrics::Euclidean>(feature_vectors, layout, options.threads);
+    }
+}
+
+/**
+ * Groups identical points of a precomputed distance matrix, i.e. points at distance zero whose distances to all other
+ * points agree, which is what identical feature vectors amount to. The groups are ordered by their first index like
+ * the groups of feature vectors.
+ * @param matrix - the precomputed distances
+ * @param points - the points of the matrix that are clustered, in ascending order
+ * @param collapse - whether identical points are grouped at all, otherwise every point forms its own group
+ * @return the groups of identical points as indices into points
+ */
+inline std::vector<std::vector<size_t> > getduplicategroups(CondensedMatrix const &matrix,
+                                                            const std::vector<size_t> &points, bool collapse) {
+    std::vector<std::vector<size_t> > groups;
+    groups.reserve(points.size());
+    std::vector<long> group_of(points.size(), -1);
+    for (size_t i = 0; i < points.size(); i++) {
+        if (group_of[i] >= 0) {
+            groups[group_of[i]].push_back(i);
+            continue;
+        }
+        group_of[i] = (long) groups.size();
+        groups.emplace_back(1, i);
+        if (!collapse) {
+            continue;
+        }
+        // the later points of the group are found in the contiguous row of its first point
+        const double *distances = matrix.row(points[i]);
+        for (size_t j = i + 1; j < points.size(); j++) {
+            if (group_of[j] >= 0 || distances[points[j] - points[i] - 1] != 0.0) {
+                continue;
+            }
+            bool same = true;
+            for (size_t k = 0; k < points.size() && same; k++) {
+                same = k == i || k == j || matrix.at(points[i], points[k]) == matrix.at(points[j], points[k]);
+            }
+            if (same) {
+                group_of[j] = group_of[i];
+            }
+        }
+    }
+    return groups;
+}
+
+/**
+ * Get the initial distances between groups of points from a precomputed distance matrix, which are read straight from
+ * the matrix into the given layout.
+ * @param matrix - the precomputed distances
+ * @param points - the points of the matrix that are clustered, in ascending order
+ * @param groups - the groups of identical points as indices into points, each described by its first point
+ * @param layout - the layout of the returned distances
+ * @return the precomputed distances between all groups as constant functions of alpha
+ */
+inline DistanceFunctions getdists(CondensedMatrix const &matrix, const std::vector<size_t> &points,
+                                  const std::vector<std::vector<size_t> > &groups, DistanceLayout const &layout) {
+    DistanceFunctions dists(layout.entries(), InterpolatedDistance(0.0, 0.0));
+    size_t len = layout.width;
+    for (size_t i = 0; i < len; i++) {
+        long row = layout.row_base((long) i);
+        size_t first = points[groups[i][0]];
+        const double *distances = matrix.row(first);
+        for (size_t j = i + 1; j < len; j++) {
+            double dist = distances[points[groups[j][0]] - first - 1];
+            dists[row + j] = InterpolatedDistance(dist, dist);
+            if (layout.is_square()) {
+                dists[j * layout.stride + i] = dists[row + j];
+            }
         }
     }
     return dists;
 }
 
+/**
+ * Get the initial row bounds of the filtering index, i.e. for every cluster i the smallest distance to any cluster j > i.
+ * @param dists - the initial distances between all points
+ * @param layout - the layout of the distances
+ * @return the smallest distance in each row of the upper triangle, infinity for the last row
+ */
+inline std::vector<double> get_row_bounds(DistanceFunctions const &dists, DistanceLayout const &layout) {
+    std::vector<double> row_bounds(layout.width, std::numeric_limits<double>::infinity());
+    for (size_t i = 0; i < layout.width; i++) {
+        long row = layout.row_base(i);
+        for (size_t j = i + 1; j < layout.width; j++) {
+            row_bounds[i] = std::min(row_bounds[i], dists[row + j].lower);
+        }
+    }
+    return row_bounds;
+}
+
+/**
+ * Gets the initial nodes of grouped points. Identical points have distance zero, so the linkage would merge them
+ * first, always keeping the smaller index. Each group therefore starts as the left-deep chain of its points that these
+ * merges produce, whose root carries the label counts (i.e. the multiplicities or the label histogram of a coreset
+ * representative) of the whole group.
+ * @param leaves - the nodes of all points
+ * @param groups - the groups of points
+ * @return one initial node per group
+ */
+inline std::vector<ClusterNode *> getgroupnodes(const std::vector<ClusterNode *> &leaves,
+                                                const std::vector<std::vector<size_t> > &groups) {
+    std::vector<ClusterNode *> nodes;
+    nodes.reserve(groups.size());
+    for (std::vector<size_t> const &group : groups) {
+        ClusterNode *node = leaves[group[0]];
+        for (size_t m = 1; m < group.size(); m++) {
+            node = new ClusterNode(node, leaves[group[m]]);
+        }
+        nodes.push_back(node);
+    }
+    return nodes;
+}
+
 /**
  * Gets the initial nodes for a clustering, where each node represents one point
  * @tparam T - the numeric label type
@@ -38,7 +321,7 @@ std::vector<ClusterNode *> getnodes(const std::vector<T> &concrete_labels, const
     for (auto i = 0; i < concrete_labels.size(); i++) {
         auto pos = std::find(different_labels.begin(), different_labels.end(), concrete_labels[i]) -
                    different_labels.begin();
-        std::vector<int> counts(different_labels.size(), 0);
+        LabelCounts counts(different_labels.size());
         counts[pos] = 1;
         nodes.push_back(new ClusterNode(NULL, NULL, counts, false));
     }
@@ -52,19 +335,26 @@ std::vector<ClusterNode *> getnodes(const std::vector<T> &concrete_labels, const
   * @param feature_vectors - input feature vectors
   * @param concrete_labels - all labels
   * @param different_labels - all unique labels
+  * @param options - the layout and metric of the distances and how points are grouped into initial clusters
   */
 template<typename T>
 void getinitstate(SC_State &state, const std::vector<std::vector<T> > &feature_vectors,
-                  const std::vector<T> &concrete_labels, const std::vector<T> &different_labels) {
-    std::vector<double> minmaxdists = getdists(feature_vectors, concrete_labels.size());
-    std::vector<ClusterNode *> nodes = getnodes(concrete_labels, Helpers::getUniqueValues(concrete_labels));
+                  const std::vector<T> &concrete_labels, const std::vector<T> &different_labels,
+                  LinkageOptions const &options) {
+    std::vector<std::vector<T> > representatives;
+    std::vector<std::vector<size_t> > groups = getpointgroups(feature_vectors, options, representatives);
+    DistanceLayout layout = choose_layout(groups.size(), options.layout);
+    DistanceFunctions dists = getdists(representatives, layout, options);
+    std::vector<ClusterNode *> nodes = getgroupnodes(
+            getnodes(concrete_labels, Helpers::getUniqueValues(concrete_labels)), groups);
     std::vector<long> active_indices;
-    std::vector<short> cluster_sizes;
-    active_indices.reserve(concrete_labels.size());
-    for (auto i = 0; i < concrete_labels.size(); i++) {
+    active_indices.reserve(groups.size());
+    for (auto i = 0; i < groups.size(); i++) {
         active_indices.push_back(i);
     }
-    state = SC_State(0.0, 1.0, minmaxdists, minmaxdists, active_indices, nodes);
+    std::vector<double> row_bounds = get_row_bounds(dists, layout);
+    state = SC_State(options.alpha_start, options.alpha_end, std::move(dists), layout, std::move(row_bounds),
+                     active_indices, nodes);
 }
 
 /**
@@ -74,19 +364,26 @@ void getinitstate(SC_State &state, const std::vector<std::vector<T> > &feature_v
  * @param feature_vectors - input feature vectors
  * @param concrete_labels - all labels
  * @param different_labels - all unique labels
+ * @param options - the layout and metric of the distances and how points are grouped into weighted initial clusters
  */
 template<typename T>
 void getinitstate(SA_State &state, const std::vector<std::vector<T> > &feature_vectors,
-                  const std::vector<T> &concrete_labels, const std::vector<T> &different_labels) {
-    std::vector<double> minavgdists = getdists(feature_vectors, concrete_labels.size());
-    std::vector<ClusterNode *> nodes = getnodes(concrete_labels, different_labels);
+                  const std::vector<T> &concrete_labels, const std::vector<T> &different_labels,
+                  LinkageOptions const &options) {
+    std::vector<std::vector<T> > representatives;
+    std::vector<std::vector<size_t> > groups = getpointgroups(feature_vectors, options, representatives);
+    DistanceLayout layout = choose_layout(groups.size(), options.layout);
+    DistanceFunctions dists = getdists(representatives, layout, options);
+    std::vector<ClusterNode *> nodes = getgroupnodes(getnodes(concrete_labels, different_labels), groups);
     std::vector<long> active_indices;
-    std::vector<short> cluster_sizes;
-    for (auto i = 0; i < concrete_labels.size(); i++) {
+    std::vector<int> cluster_sizes;
+    for (auto i = 0; i < groups.size(); i++) {
         active_indices.push_back(i);
-        cluster_sizes.push_back(1);
+        cluster_sizes.push_back((int) groups[i].size());
     }
-    state = SA_State(0.0, 1.0, minavgdists, minavgdists, active_indices, nodes, cluster_sizes);
+    std::vector<double> row_bounds = get_row_bounds(dists, layout);
+    state = SA_State(options.alpha_start, options.alpha_end, std::move(dists), layout, std::move(row_bounds),
+                     active_indices, nodes, cluster_sizes);
 }
 
 /**
@@ -96,20 +393,238 @@ void getinitstate(SA_State &state, const std::vector<std::vector<T> > &feature_v
  * @param feature_vectors - input feature vectors
  * @param concrete_labels - all labels
  * @param different_labels - all unique labels
+ * @param options - the layout and metric of the distances and how points are grouped into weighted initial clusters
  */
 template<typename T>
 void getinitstate(AC_State &state, const std::vector<std::vector<T> > &feature_vectors,
-                  const std::vector<T> &concrete_labels, const std::vector<T> &different_labels) {
-    std::vector<double> avgmaxdists = getdists(feature_vectors, concrete_labels.size());
-    std::vector<ClusterNode *> nodes = getnodes(concrete_labels, different_labels);
+                  const std::vector<T> &concrete_labels, const std::vector<T> &different_labels,
+                  LinkageOptions const &options) {
+    std::vector<std::vector<T> > representatives;
+    std::vector<std::vector<size_t> > groups = getpointgroups(feature_vectors, options, representatives);
+    DistanceLayout layout = choose_layout(groups.size(), options.layout);
+    DistanceFunctions dists = getdists(representatives, layout, options);
+    std::vector<ClusterNode *> nodes = getgroupnodes(getnodes(concrete_labels, different_labels), groups);
     std::vector<long> active_indices;
-    std::vector<short> cluster_sizes;
-    for (auto i = 0; i < concrete_labels.size(); i++) {
+    std::vector<int> cluster_sizes;
+    for (auto i = 0; i < groups.size(); i++) {
+        active_indices.push_back(i);
+        cluster_sizes.push_back((int) groups[i].size());
+    }
+    std::vector<double> row_bounds = get_row_bounds(dists, layout);
+    state = AC_State(options.alpha_start, options.alpha_end, std::move(dists), layout, std::move(row_bounds),
+                     active_indices, nodes, cluster_sizes);
+}
+
+/**
+ * Get the initial SC_State from a precomputed distance matrix and labels without redundant distance values
+ * @tparam T - the numeric label type
+ * @param state - the output initial state
+ * @param matrix - the precomputed distances
+ * @param points - the points of the matrix that are clustered, in ascending order
+ * @param concrete_labels - the labels of these points
+ * @param different_labels - all unique labels
+ * @param options - the layout of the distances and whether identical points are grouped
+ */
+template<typename T>
+void getinitstate(SC_State &state, CondensedMatrix const &matrix, const std::vector<size_t> &points,
+                  const std::vector<T> &concrete_labels, const std::vector<T> &different_labels,
+                  LinkageOptions const &options) {
+    std::vector<std::vector<size_t> > groups = getduplicategroups(matrix, points, options.collapse_duplicates);
+    DistanceLayout layout = choose_layout(groups.size(), options.layout);
+    DistanceFunctions dists = getdists(matrix, points, groups, layout);
+    std::vector<ClusterNode *> nodes = getgroupnodes(
+            getnodes(concrete_labels, Helpers::getUniqueValues(concrete_labels)), groups);
+    std::vector<long> active_indices;
+    active_indices.reserve(groups.size());
+    for (auto i = 0; i < groups.size(); i++) {
+        active_indices.push_back(i);
+    }
+    std::vector<double> row_bounds = get_row_bounds(dists, layout);
+    state = SC_State(options.alpha_start, options.alpha_end, std::move(dists), layout, std::move(row_bounds),
+                     active_indices, nodes);
+}
+
+/**
+ * Get the initial SA_State from a precomputed distance matrix and labels without redundant distance values
+ * @tparam T - the numeric label type
+ * @param state - the output initial state
+ * @param matrix - the precomputed distances
+ * @param points - the points of the matrix that are clustered, in ascending order
+ * @param concrete_labels - the labels of these points
+ * @param different_labels - all unique labels
+ * @param options - the layout of the distances and whether identical points are grouped into weighted clusters
+ */
+template<typename T>
+void getinitstate(SA_State &state, CondensedMatrix const &matrix, const std::vector<size_t> &points,
+                  const std::vector<T> &concrete_labels, const std::vector<T> &different_labels,
+                  LinkageOptions const &options) {
+    std::vector<std::vector<size_t> > groups = getduplicategroups(matrix, points, options.collapse_duplicates);
+    DistanceLayout layout = choose_layout(groups.size(), options.layout);
+    DistanceFunctions dists = getdists(matrix, points, groups, layout);
+    std::vector<ClusterNode *> nodes = getgroupnodes(getnodes(concrete_labels, different_labels), groups);
+    std::vector<long> active_indices;
+    std::vector<int> cluster_sizes;
+    for (auto i = 0; i < groups.size(); i++) {
+        active_indices.push_back(i);
+        cluster_sizes.push_back((int) groups[i].size());
+    }
+    std::vector<double> row_bounds = get_row_bounds(dists, layout);
+    state = SA_State(options.alpha_start, options.alpha_end, std::move(dists), layout, std::move(row_bounds),
+                     active_indices, nodes, cluster_sizes);
+}
+
+/**
+ * Get the initial AC_State from a precomputed distance matrix and labels without redundant distance values
+ * @tparam T - the numeric label type
+ * @param state - the output initial state
+ * @param matrix - the precomputed distances
+ * @param points - the points of the matrix that are clustered, in ascending order
+ * @param concrete_labels - the labels of these points
+ * @param different_labels - all unique labels
+ * @param options - the layout of the distances and whether identical points are grouped into weighted clusters
+ */
+template<typename T>
+void getinitstate(AC_State &state, CondensedMatrix const &matrix, const std::vector<size_t> &points,
+                  const std::vector<T> &concrete_labels, const std::vector<T> &different_labels,
+                  LinkageOptions const &options) {
+    std::vector<std::vector<size_t> > groups = getduplicategroups(matrix, points, options.collapse_duplicates);
+    DistanceLayout layout = choose_layout(groups.size(), options.layout);
+    DistanceFunctions dists = getdists(matrix, points, groups, layout);
+    std::vector<ClusterNode *> nodes = getgroupnodes(getnodes(concrete_labels, different_labels), groups);
+    std::vector<long> active_indices;
+    std::vector<int> cluster_sizes;
+    for (auto i = 0; i < groups.size(); i++) {
         active_indices.push_back(i);
-        cluster_sizes.push_back(1);
+        cluster_sizes.push_back((int) groups[i].size());
     }
-    state = AC_State(0.0, 1.0, avgmaxdists, avgmaxdists, active_indices, nodes, cluster_sizes);
+    std::vector<double> row_bounds = get_row_bounds(dists, layout);
+    state = AC_State(options.alpha_start, options.alpha_end, std::move(dists), layout, std::move(row_bounds),
+                     active_indices, nodes, cluster_sizes);
+}
+
+/**
+ * Sparse states search the neighbours of the points and later their exact distances in the feature vectors, which a
+ * precomputed distance matrix does not have.
+ * @param state - stays without clusters
+ */
+template<typename T>
+void getinitstate(SparseSC_State &state, CondensedMatrix const &matrix, const std::vector<size_t> &points,
+                  const std::vector<T> &concrete_labels, const std::vector<T> &different_labels,
+                  LinkageOptions const &options) {
+    std::cerr << "Sparse states need the feature vectors of the points." << std::endl;
 }
 
+/// number of points whose neighbours are searched together against a block of as many candidates, which keeps both
+/// blocks in cache during the brute-force search
+const size_t neighbour_block_points = 256;
+
+/**
+ * Builds the symmetric k-nearest-neighbour graph of all points by a blocked brute-force search, i.e. two points are
+ * connected if one of them is among the k nearest points of the other. Blocks of points are searched in parallel.
+ * @tparam T - the numeric feature type
+ * @param feature_vectors - a vector of all feature vectors (i.e. points)
+ * @param k - the number of nearest neighbours of every point
+ * @param threads - the number of threads used for the search
+ * @param rows - receives the edges of each point as constant distance functions, ordered by the other point
+ * @param radii - receives the distance of each point to its k-th nearest neighbour, all points that are no edge of
+ * the point are at least as far away; infinity if every other point is a neighbour
+ */
+template<typename T>
+void get_neighbour_graph(const std::vector<std::vector<T> > &feature_vectors, size_t k, size_t threads,
+                         std::vector<SparseRow> &rows, std::vector<double> &radii) {
+    size_t len = feature_vectors.size();
+    size_t blocks = (len + neighbour_block_points - 1) / neighbour_block_points;
+    // the k nearest points of every point as max-heaps, ties are broken by the point index
+    std::vector<std::vector<std::pair<double, long> > > nearest(len);
+    threads = std::max<size_t>(1, std::min(threads, blocks));
+    Parallel::run_chunks(threads, [&](size_t c) {
+        for (size_t block = c; block < blocks; block += threads) {
+            size_t first = block * neighbour_block_points;
+            size_t last = std::min(len, first + neighbour_block_points);
+            for (size_t candidates = 0; candidates < len; candidates += neighbour_block_points) {
+                size_t candidates_end = std::min(len, candidates + neighbour_block_points);
+                for (size_t p = first; p < last; p++) {
+                    std::vector<std::pair<double, long> > &heap = nearest[p];
+                    for (size_t q = candidates; q < candidates_end; q++) {
+                        if (q == p) {
+                            continue;
+                        }
+                        std::pair<double, long> neighbour(
+                                DistanceFunction::euclidean_dist(feature_vectors[p], feature_vectors[q]), (long) q);
+                        if (heap.size() < k) {
+                            heap.push_back(neighbour);
+                            std::push_heap(heap.begin(), heap.end());
+                        } else if (neighbour < heap.front()) {
+                            std::pop_heap(heap.begin(), heap.end());
+                            heap.back() = neighbour;
+                            std::push_heap(heap.begin(), heap.end());
+                        }
+                    }
+                }
+            }
+        }
+    });
+    rows.assign(len, SparseRow());
+    radii.assign(len, std::numeric_limits<double>::infinity());
+    for (size_t p = 0; p < len; p++) {
+        if (nearest[p].size() == k && k + 1 < len) {
+            radii[p] = nearest[p].front().first;
+        }
+        for (std::pair<double, long> const &neighbour : nearest[p]) {
+            rows[p].emplace_back(neighbour.second, InterpolatedDistance(neighbour.first, neighbour.first), 1);
+            rows[neighbour.second].emplace_back((long) p, InterpolatedDistance(neighbour.first, neighbour.first), 1);
+        }
+    }
+    for (SparseRow &row : rows) {
+        std::sort(row.begin(), row.end(), [](SparseEdge const &e1, SparseEdge const &e2) {
+            return e1.cluster < e2.cluster;
+        });
+        row.erase(std::unique(row.begin(), row.end(), [](SparseEdge const &e1, SparseEdge const &e2) {
+            return e1.cluster == e2.cluster;
+        }), row.end());
+    }
+}
+
+/**
+ * Get the initial SparseSC_State from feature vectors and labels, which only knows the distances along the edges of the
+ * k-nearest-neighbour graph of the points
+ * @tparam T - the numeric label type
+ * @param state - the output initial state
+ * @param feature_vectors - input feature vectors
+ * @param concrete_labels - all labels
+ * @param different_labels - all unique labels
+ * @param options - the number of neighbours, the threads for the graph and how points are grouped into initial
+ * clusters
+ */
+template<typename T>
+void getinitstate(SparseSC_State &state, const std::vector<std::vector<T> > &feature_vectors,
+                  const std::vector<T> &concrete_labels, const std::vector<T> &different_labels,
+                  LinkageOptions const &options) {
+    std::vector<std::vector<T> > representatives;
+    std::vector<std::vector<size_t> > groups = getpointgroups(feature_vectors, options, representatives);
+    auto points = std::make_shared<const std::vector<std::vector<T> > >(std::move(representatives));
+    std::vector<SparseRow> rows;
+    std::vector<double> radii;
+    get_neighbour_graph(*points, options.sparse_neighbours, options.threads, rows, radii);
+    std::vector<ClusterNode *> nodes = getgroupnodes(
+            getnodes(concrete_labels, Helpers::getUniqueValues(concrete_labels)), groups);
+    std::vector<long> active_indices;
+    std::vector<std::vector<long> > members;
+    std::vector<double> row_bounds(groups.size(), std::numeric_limits<double>::infinity());
+    long edges = 0;
+    for (auto i = 0; i < groups.size(); i++) {
+        active_indices.push_back(i);
+        members.emplace_back(1, i);
+        for (SparseEdge const &edge : rows[i]) {
+            if (edge.cluster > i) {
+                row_bounds[i] = std::min(row_bounds[i], edge.f.lower);
+                edges++;
+            }
+        }
+    }
+    state = SparseSC_State(options.alpha_start, options.alpha_end, std::move(rows), std::move(row_bounds),
+                           std::move(radii), std::move(members), points, active_indices, nodes);
+    state.edges = edges;
+}
 
 #endif /* InitOperations_h */
@@ -0,0 +1,75 @@
+#ifndef Isa_h
+#define Isa_h
+
+#include <string>
+
+/// instruction sets that the scan kernels are built for, in ascending order
+enum IsaLevel {
+    ISA_SSE2 = 0, ISA_AVX2 = 1, ISA_AVX512 = 2
+};
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define ISA_X86 1
+#else
+#define ISA_X86 0
+#endif
+
+namespace Isa {
+
+    /**
+     * Detects the highest instruction set of the processor that the kernels are built for.
+     * @return the detected level, ISA_SSE2 on other architectures
+     */
+    inline IsaLevel detect() {
+#if ISA_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            return ISA_AVX512;
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            return ISA_AVX2;
+        }
+#endif
+        return ISA_SSE2;
+    }
+
+    /**
+     * Gets the instruction set that the kernels use, which is detected on first use.
+     * @return the level of the kernels
+     */
+    inline IsaLevel &level() {
+        static IsaLevel selected = detect();
+        return selected;
+    }
+
+    /**
+     * Gets the name of an instruction set.
+     * @param isa - the level
+     * @return sse2, avx2 or avx512
+     */
+    inline std::string name(IsaLevel isa) {
+        return isa == ISA_AVX512 ? "avx512" : isa == ISA_AVX2 ? "avx2" : "sse2";
+    }
+
+    /**
+     * Overrides the detected instruction set of the kernels, e.g. to compare the variants.
+     * @param isa_name - sse2, avx2, avx512 or auto for the detected one
+     * @return if the name is known and the processor supports it
+     */
+    inline bool select(std::string const &isa_name) {
+        IsaLevel supported = detect();
+        for (IsaLevel isa : {ISA_SSE2, ISA_AVX2, ISA_AVX512}) {
+            if (isa_name == name(isa) && isa <= supported) {
+                level() = isa;
+                return true;
+            }
+        }
+        if (isa_name == "auto") {
+            level() = supported;
+            return true;
+        }
+        return false;
+    }
+}
+
+#endif /* Isa_h */
@@ -0,0 +1,377 @@
+#ifndef Kernels_h
+#define Kernels_h
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+
+#include "InterpolatedDistance.h"
+
+#include "Isa.h"
+
+#if ISA_X86
+#include <immintrin.h>
+#endif
+
+/*!
+ * Scan kernels in one variant per instruction set, chosen at runtime by Isa::level(). Each kernel scans one row of the
+ * distance functions, whose pairs are gathered by the indices of the active clusters, and returns the best pair of the
+ * row under the same total order as the scalar scan, so the results do not depend on the variant. Every variant rounds
+ * like the scalar code, which is why the build disables the contraction of multiplications and additions into fused
+ * ones.
+ */
+namespace Kernels {
+
+    /// position of a row's best pair if the row has none
+    const size_t no_position = std::numeric_limits<size_t>::max();
+
+    /*!
+     * Best pair of a row for one value of alpha, ordered by distance, slope and position like BestMerge.
+     */
+    struct RowBest {
+        double dist;
+        double slope;
+        size_t position;
+
+        RowBest() : dist(std::numeric_limits<double>::infinity()), slope(std::numeric_limits<double>::infinity()),
+                    position(no_position) {}
+
+        void offer(double d, double a, size_t p) {
+            if (d < dist || (d == dist && (a < slope || (a == slope && p < position)))) {
+                dist = d;
+                slope = a;
+                position = p;
+            }
+        }
+    };
+
+    /*!
+     * Nearest intersection of a row inside an interval, the first pair of several equally near ones.
+     */
+    struct RowNearest {
+        double alpha;
+        size_t position;
+
+        RowNearest() : alpha(std::numeric_limits<double>::infinity()), position(no_position) {}
+
+        void offer(double x, size_t p) {
+            if (x < alpha || (x == alpha && p < position)) {
+                alpha = x;
+                position = p;
+            }
+        }
+    };
+
+    /**
+     * Checks whether the kernels run vectorized, otherwise the scalar scans are used as they are.
+     * @return if the selected instruction set has a vector variant
+     */
+    inline bool vectorized() {
+        return Isa::level() != ISA_SSE2;
+    }
+
+    /**
+     * Finds the best pairs of a row at both ends of an alpha interval.
+     * @param dists - the pairwise distance functions
+     * @param base - the index of the row's pair with cluster 0, i.e. the row_base of the layout
+     * @param cols - the clusters of the row's pairs in ascending order
+     * @param first - position of the first scanned pair
+     * @param count - the number of pairs
+     * @param alpha_min - lower end of the interval
+     * @param alpha_max - upper end of the interval
+     * @param at_min - receives the best pair at alpha_min
+     * @param at_max - receives the best pair at alpha_max
+     * @return the smallest distance of the scanned pairs within the interval
+     */
+    inline double row_candidates_sse2(InterpolatedDistance const *dists, long base, long const *cols, size_t first,
+                                      size_t count, double alpha_min, double alpha_max, RowBest &at_min,
+                                      RowBest &at_max) {
+        double row_min = std::numeric_limits<double>::infinity();
+        for (size_t j = first; j < count; j++) {
+            InterpolatedDistance const &f = dists[base + cols[j]];
+            double dist_min = f.at(alpha_min);
+            double dist_max = f.at(alpha_max);
+            at_min.offer(dist_min, f.slope(), j);
+            at_max.offer(dist_max, f.slope(), j);
+            row_min = std::min(row_min, std::min(dist_min, dist_max));
+        }
+        return row_min;
+    }
+
+    /**
+     * Finds the nearest intersection of a function with the pairs of a row inside (alpha_start, alpha_end).
+     * @param dists - the pairwise distance functions
+     * @param base - the index of the row's pair with cluster 0, i.e. the row_base of the layout
+     * @param cols - the clusters of the row's pairs
+     * @param first - position of the first scanned pair
+     * @param count - the number of pairs
+     * @param lf_in - the intersected function
+     * @param alpha_start - exclusive lower end of the interval
+     * @param alpha_end - exclusive upper end of the interval
+     * @param nearest - receives the nearest intersection
+     */
+    inline void nearest_intersection_sse2(InterpolatedDistance const *dists, long base, long const *cols, size_t first,
+                                          size_t count, LinearFunction lf_in, double alpha_start, double alpha_end,
+                                          RowNearest &nearest) {
+        for (size_t j = first; j < count; j++) {
+            double intersection = lf_in.calculate_interaction_with(dists[base + cols[j]].function());
+            if (intersection < alpha_end && intersection > alpha_start) {
+                nearest.offer(intersection, j);
+            }
+        }
+    }
+
+#if ISA_X86
+
+    __attribute__((target("avx2")))
+    inline double row_candidates_avx2(InterpolatedDistance const *dists, long base, long const *cols, size_t count,
+                                      double alpha_min, double alpha_max, RowBest &at_min, RowBest &at_max) {
+        auto values = reinterpret_cast<double const *>(dists);
+        __m256d infinity = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+        __m256d min_alpha = _mm256_set1_pd(alpha_min), min_rest = _mm256_set1_pd(1 - alpha_min);
+        __m256d max_alpha = _mm256_set1_pd(alpha_max), max_rest = _mm256_set1_pd(1 - alpha_max);
+        __m256i offset = _mm256_set1_epi64x(base);
+        __m256d min_dist = infinity, min_slope = infinity, max_dist = infinity, max_slope = infinity;
+        __m256d row_min = infinity;
+        __m256i min_position = _mm256_setzero_si256(), max_position = _mm256_setzero_si256();
+        __m256i position = _mm256_setr_epi64x(0, 1, 2, 3);
+        __m256i step = _mm256_set1_epi64x(4);
+        size_t j = 0;
+        for (; j + 4 <= count; j += 4) {
+            // the lower and upper distance of pair k are the doubles 2k and 2k + 1
+            __m256i index = _mm256_slli_epi64(
+                    _mm256_add_epi64(_mm256_loadu_si256(reinterpret_cast<__m256i const *>(cols + j)), offset), 1);
+            __m256d lower = _mm256_i64gather_pd(values, index, 8);
+            __m256d upper = _mm256_i64gather_pd(values + 1, index, 8);
+            __m256d a = _mm256_sub_pd(upper, lower);
+            __m256d dist_min = _mm256_add_pd(_mm256_mul_pd(min_rest, lower), _mm256_mul_pd(min_alpha, upper));
+            __m256d dist_max = _mm256_add_pd(_mm256_mul_pd(max_rest, lower), _mm256_mul_pd(max_alpha, upper));
+
+            // every lane keeps its first best pair, later pairs of a lane only win if they are strictly better
+            __m256d better = _mm256_or_pd(_mm256_cmp_pd(dist_min, min_dist, _CMP_LT_OQ),
+                                          _mm256_and_pd(_mm256_cmp_pd(dist_min, min_dist, _CMP_EQ_OQ),
+                                                        _mm256_cmp_pd(a, min_slope, _CMP_LT_OQ)));
+            min_dist = _mm256_blendv_pd(min_dist, dist_min, better);
+            min_slope = _mm256_blendv_pd(min_slope, a, better);
+            min_position = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(min_position),
+                                                                _mm256_castsi256_pd(position), better));
+            better = _mm256_or_pd(_mm256_cmp_pd(dist_max, max_dist, _CMP_LT_OQ),
+                                  _mm256_and_pd(_mm256_cmp_pd(dist_max, max_dist, _CMP_EQ_OQ),
+                                                _mm256_cmp_pd(a, max_slope, _CMP_LT_OQ)));
+            max_dist = _mm256_blendv_pd(max_dist, dist_max, better);
+            max_slope = _mm256_blendv_pd(max_slope, a, better);
+            max_position = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(max_position),
+                                                                _mm256_castsi256_pd(position), better));
+            row_min = _mm256_min_pd(_mm256_min_pd(dist_min, dist_max), row_min);
+            position = _mm256_add_epi64(position, step);
+        }
+        double lanes[6][4];
+        long lane_positions[2][4];
+        _mm256_storeu_pd(lanes[0], min_dist);
+        _mm256_storeu_pd(lanes[1], min_slope);
+        _mm256_storeu_pd(lanes[2], max_dist);
+        _mm256_storeu_pd(lanes[3], max_slope);
+        _mm256_storeu_pd(lanes[4], row_min);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lane_positions[0]), min_position);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lane_positions[1]), max_position);
+        double result = row_candidates_sse2(dists, base, cols, j, count, alpha_min, alpha_max, at_min, at_max);
+        for (int lane = 0; lane < 4 && j > 0; lane++) {
+            at_min.offer(lanes[0][lane], lanes[1][lane], (size_t) lane_positions[0][lane]);
+            at_max.offer(lanes[2][lane], lanes[3][lane], (size_t) lane_positions[1][lane]);
+            result = std::min(result, lanes[4][lane]);
+        }
+        return result;
+    }
+
+    __attribute__((target("avx2")))
+    inline void nearest_intersection_avx2(InterpolatedDistance const *dists, long base, long const *cols, size_t count,
+                                          LinearFunction lf_in, double alpha_start, double alpha_end,
+                                          RowNearest &nearest) {
+        auto values = reinterpret_cast<double const *>(dists);
+        __m256d lane_nearest = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+        __m256i lane_position = _mm256_setzero_si256();
+        __m256d in_a = _mm256_set1_pd(lf_in.a);
+        __m256d in_b = _mm256_set1_pd(lf_in.b);
+        __m256d start = _mm256_set1_pd(alpha_start);
+        __m256d end = _mm256_set1_pd(alpha_end);
+        __m256i offset = _mm256_set1_epi64x(base);
+        __m256i position = _mm256_setr_epi64x(0, 1, 2, 3);
+        __m256i step = _mm256_set1_epi64x(4);
+        size_t j = 0;
+        for (; j + 4 <= count; j += 4) {
+            __m256i index = _mm256_slli_epi64(
+                    _mm256_add_epi64(_mm256_loadu_si256(reinterpret_cast<__m256i const *>(cols + j)), offset), 1);
+            __m256d b = _mm256_i64gather_pd(values, index, 8);
+            __m256d a = _mm256_sub_pd(_mm256_i64gather_pd(values + 1, index, 8), b);
+            __m256d intersection = _mm256_div_pd(_mm256_sub_pd(b, in_b), _mm256_sub_pd(in_a, a));
+            __m256d better = _mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(intersection, end, _CMP_LT_OQ),
+                                                         _mm256_cmp_pd(intersection, start, _CMP_GT_OQ)),
+                                           _mm256_cmp_pd(intersection, lane_nearest, _CMP_LT_OQ));
+            lane_nearest = _mm256_blendv_pd(lane_nearest, intersection, better);
+            lane_position = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(lane_position),
+                                                                 _mm256_castsi256_pd(position), better));
+            position = _mm256_add_epi64(position, step);
+        }
+        double lanes[4];
+        long lane_positions[4];
+        _mm256_storeu_pd(lanes, lane_nearest);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lane_positions), lane_position);
+        for (int lane = 0; lane < 4; lane++) {
+            if (lanes[lane] < alpha_end) {
+                nearest.offer(lanes[lane], (size_t) lane_positions[lane]);
+            }
+        }
+        nearest_intersection_sse2(dists, base, cols, j, count, lf_in, alpha_start, alpha_end, nearest);
+    }
+
+    __attribute__((target("avx512f")))
+    inline double row_candidates_avx512(InterpolatedDistance const *dists, long base, long const *cols, size_t count,
+                                        double alpha_min, double alpha_max, RowBest &at_min, RowBest &at_max) {
+        auto values = reinterpret_cast<double const *>(dists);
+        __m512d infinity = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+        __m512d min_alpha = _mm512_set1_pd(alpha_min), min_rest = _mm512_set1_pd(1 - alpha_min);
+        __m512d max_alpha = _mm512_set1_pd(alpha_max), max_rest = _mm512_set1_pd(1 - alpha_max);
+        __m512i offset = _mm512_set1_epi64(base);
+        __m512d min_dist = infinity, min_slope = infinity, max_dist = infinity, max_slope = infinity;
+        __m512d row_min = infinity;
+        __m512i min_position = _mm512_setzero_si512(), max_position = _mm512_setzero_si512();
+        __m512i position = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+        __m512i step = _mm512_set1_epi64(8);
+        size_t j = 0;
+        for (; j + 8 <= count; j += 8) {
+            __m512i index = _mm512_slli_epi64(_mm512_add_epi64(_mm512_loadu_si512(cols + j), offset), 1);
+            __m512d lower = _mm512_i64gather_pd(index, values, 8);
+            __m512d upper = _mm512_i64gather_pd(index, values + 1, 8);
+            __m512d a = _mm512_sub_pd(upper, lower);
+            __m512d dist_min = _mm512_add_pd(_mm512_mul_pd(min_rest, lower), _mm512_mul_pd(min_alpha, upper));
+            __m512d dist_max = _mm512_add_pd(_mm512_mul_pd(max_rest, lower), _mm512_mul_pd(max_alpha, upper));
+            __mmask8 better = _mm512_cmp_pd_mask(dist_min, min_dist, _CMP_LT_OQ) |
+                              (_mm512_cmp_pd_mask(dist_min, min_dist, _CMP_EQ_OQ) &
+                               _mm512_cmp_pd_mask(a, min_slope, _CMP_LT_OQ));
+            min_dist = _mm512_mask_blend_pd(better, min_dist, dist_min);
+            min_slope = _mm512_mask_blend_pd(better, min_slope, a);
+            min_position = _mm512_mask_blend_epi64(better, min_position, position);
+            better = _mm512_cmp_pd_mask(dist_max, max_dist, _CMP_LT_OQ) |
+                     (_mm512_cmp_pd_mask(dist_max, max_dist, _CMP_EQ_OQ) &
+                      _mm512_cmp_pd_mask(a, max_slope, _CMP_LT_OQ));
+            max_dist = _mm512_mask_blend_pd(better, max_dist, dist_max);
+            max_slope = _mm512_mask_blend_pd(better, max_slope, a);
+            max_position = _mm512_mask_blend_epi64(better, max_position, position);
+            row_min = _mm512_min_pd(_mm512_min_pd(dist_min, dist_max), row_min);
+            position = _mm512_add_epi64(position, step);
+        }
+        double lanes[5][8];
+        long lane_positions[2][8];
+        _mm512_storeu_pd(lanes[0], min_dist);
+        _mm512_storeu_pd(lanes[1], min_slope);
+        _mm512_storeu_pd(lanes[2], max_dist);
+        _mm512_storeu_pd(lanes[3], max_slope);
+        _mm512_storeu_pd(lanes[4], row_min);
+        _mm512_storeu_si512(lane_positions[0], min_position);
+        _mm512_storeu_si512(lane_positions[1], max_position);
+        double result = row_candidates_sse2(dists, base, cols, j, count, alpha_min, alpha_max, at_min, at_max);
+        for (int lane = 0; lane < 8 && j > 0; lane++) {
+            at_min.offer(lanes[0][lane], lanes[1][lane], (size_t) lane_positions[0][lane]);
+            at_max.offer(lanes[2][lane], lanes[3][lane], (size_t) lane_positions[1][lane]);
+            result = std::min(result, lanes[4][lane]);
+        }
+        return result;
+    }
+
+    __attribute__((target("avx512f")))
+    inline void nearest_intersection_avx512(InterpolatedDistance const *dists, long base, long const *cols,
+                                            size_t count, LinearFunction lf_in, double alpha_start, double alpha_end,
+                                            RowNearest &nearest) {
+        auto values = reinterpret_cast<double const *>(dists);
+        __m512d lane_nearest = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+        __m512i lane_position = _mm512_setzero_si512();
+        __m512d in_a = _mm512_set1_pd(lf_in.a);
+        __m512d in_b = _mm512_set1_pd(lf_in.b);
+        __m512d start = _mm512_set1_pd(alpha_start);
+        __m512d end = _mm512_set1_pd(alpha_end);
+        __m512i offset = _mm512_set1_epi64(base);
+        __m512i position = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+        __m512i step = _mm512_set1_epi64(8);
+        size_t j = 0;
+        for (; j + 8 <= count; j += 8) {
+            __m512i index = _mm512_slli_epi64(_mm512_add_epi64(_mm512_loadu_si512(cols + j), offset), 1);
+            __m512d b = _mm512_i64gather_pd(index, values, 8);
+            __m512d a = _mm512_sub_pd(_mm512_i64gather_pd(index, values + 1, 8), b);
+            __m512d intersection = _mm512_div_pd(_mm512_sub_pd(b, in_b), _mm512_sub_pd(in_a, a));
+            __mmask8 better = _mm512_cmp_pd_mask(intersection, end, _CMP_LT_OQ) &
+                              _mm512_cmp_pd_mask(intersection, start, _CMP_GT_OQ) &
+                              _mm512_cmp_pd_mask(intersection, lane_nearest, _CMP_LT_OQ);
+            lane_nearest = _mm512_mask_blend_pd(better, lane_nearest, intersection);
+            lane_position = _mm512_mask_blend_epi64(better, lane_position, position);
+            position = _mm512_add_epi64(position, step);
+        }
+        double lanes[8];
+        long lane_positions[8];
+        _mm512_storeu_pd(lanes, lane_nearest);
+        _mm512_storeu_si512(lane_positions, lane_position);
+        for (int lane = 0; lane < 8; lane++) {
+            if (lanes[lane] < alpha_end) {
+                nearest.offer(lanes[lane], (size_t) lane_positions[lane]);
+            }
+        }
+        nearest_intersection_sse2(dists, base, cols, j, count, lf_in, alpha_start, alpha_end, nearest);
+    }
+
+#endif
+
+    /**
+     * Finds the best pairs of a row at both ends of an alpha interval with the selected instruction set.
+     * @param dists - the pairwise distance functions
+     * @param base - the index of the row's pair with cluster 0, i.e. the row_base of the layout
+     * @param cols - the clusters of the row's pairs in ascending order
+     * @param count - the number of pairs
+     * @param alpha_min - lower end of the interval
+     * @param alpha_max - upper end of the interval
+     * @param at_min - receives the best pair at alpha_min
+     * @param at_max - receives the best pair at alpha_max
+     * @return the smallest distance of the row within the interval
+     */
+    inline double row_candidates(InterpolatedDistance const *dists, long base, long const *cols, size_t count,
+                                 double alpha_min, double alpha_max, RowBest &at_min, RowBest &at_max) {
+#if ISA_X86
+        if (Isa::level() == ISA_AVX512) {
+            return row_candidates_avx512(dists, base, cols, count, alpha_min, alpha_max, at_min, at_max);
+        }
+        if (Isa::level() == ISA_AVX2) {
+            return row_candidates_avx2(dists, base, cols, count, alpha_min, alpha_max, at_min, at_max);
+        }
+#endif
+        return row_candidates_sse2(dists, base, cols, 0, count, alpha_min, alpha_max, at_min, at_max);
+    }
+
+    /**
+     * Finds the nearest intersection of a function with the pairs of a row inside (alpha_start, alpha_end) with the
+     * selected instruction set.
+     * @param dists - the pairwise distance functions
+     * @param base - the index of the row's pair with cluster 0, i.e. the row_base of the layout
+     * @param cols - the clusters of the row's pairs
+     * @param count - the number of pairs
+     * @param lf_in - the intersected function
+     * @param alpha_start - exclusive lower end of the interval
+     * @param alpha_end - exclusive upper end of the interval
+     * @return the nearest intersection, no_position if there is none
+     */
+    inline RowNearest nearest_intersection(InterpolatedDistance const *dists, long base, long const *cols, size_t count,
+                                           LinearFunction lf_in, double alpha_start, double alpha_end) {
+        RowNearest nearest;
+#if ISA_X86
+        if (Isa::level() == ISA_AVX512) {
+            nearest_intersection_avx512(dists, base, cols, count, lf_in, alpha_start, alpha_end, nearest);
+            return nearest;
+        }
+        if (Isa::level() == ISA_AVX2) {
+            nearest_intersection_avx2(dists, base, cols, count, lf_in, alpha_start, alpha_end, nearest);
+            return nearest;
+        }
+#endif
+        nearest_intersection_sse2(dists, base, cols, 0, count, lf_in, alpha_start, alpha_end, nearest);
+        return nearest;
+    }
+}
+
+#endif /* Kernels_h */
@@ -1,139 +1,388 @@
 #ifndef merge_h
 #define merge_h
 
-#define float_inf std::numeric_limits<float>::infinity()
+#include <algorithm>
+#include <limits>
 
-#include "Helpers.h"
+#include "DistanceLayout.h"
+#include "LinearFunction.h"
+#include "MergeCandidate.h"
 #include "State.h"
 
+#include "Kernels.h"
+#include "Parallel.h"
+
+/// minimum number of distance updates per task when a merge is split across threads
+const size_t merge_task_updates = 16384;
+
+/*!
+ * Best merge candidate among the pairs seen so far for one value of alpha. Pairs are ordered by their distance, then by
+ * their slope and finally by their position in the scan (i.e. by cluster1 and cluster2), which makes the result
+ * independent of the order in which the pairs are visited.
+ */
+struct BestMerge {
+    double dist;
+    LinearFunction lf;
+    MergeCandidate indices;
+
+    BestMerge() : dist(std::numeric_limits<double>::infinity()), lf(0.0, 0.0),
+                  indices(std::numeric_limits<long>::max(), std::numeric_limits<long>::max()) {}
+
+    bool improves(double d, double slope, long cluster1, long cluster2) const {
+        if (d != dist) {
+            return d < dist;
+        }
+        if (slope != lf.a) {
+            return slope < lf.a;
+        }
+        return cluster1 < indices.cluster1 || (cluster1 == indices.cluster1 && cluster2 < indices.cluster2);
+    }
+
+    void offer(BestMerge const &other) {
+        if (improves(other.dist, other.lf.a, other.indices.cluster1, other.indices.cluster2)) {
+            *this = other;
+        }
+    }
+};
+
 /**
- *
- * Calculate the pairwise sum over two vectors.
- * @tparam T - numeric feature type
- * @param a - input vector a
- * @param b - input vector b
- * @return vector of pairwise sums
+ * Scans the pairs of the row at position i of the active clusters for the merge candidates at both ends of an alpha
+ * interval and tightens the row's bound to the smallest distance of the row within the interval. With vector kernels
+ * the best pairs of the row are found by Kernels::row_candidates and then offered to the candidates.
+ * @param dists - the pairwise distance functions
+ * @param active_indices
+ * @param i - position of the row in active_indices
+ * @param alpha_min - lower end of the interval
+ * @param alpha_max - upper end of the interval
+ * @param layout - the layout of the distance functions
+ * @param row_bounds - lower bounds of the rows' distances
+ * @param at_min - receives the best candidate for alpha_min
+ * @param at_max - receives the best candidate for alpha_max
  */
-template<typename T>
-std::vector<T> operator+(const std::vector<T> &a, const std::vector<T> &b) {
-    std::vector<T> result;
-    result.reserve(a.size());
-
-    std::transform(a.begin(), a.end(), b.begin(),
-                   std::back_inserter(result), std::plus<T>());
-    return result;
+inline void find_merge_candidates_in_row(DistanceFunctions const &dists, std::vector<long> const &active_indices,
+                                         size_t i, double alpha_min, double alpha_max, DistanceLayout const &layout,
+                                         std::vector<double> &row_bounds, BestMerge &at_min, BestMerge &at_max) {
+    double dist_min, dist_max;
+    double row_min = std::numeric_limits<double>::infinity();
+    long i1 = layout.row_base(active_indices[i]);
+    if (Kernels::vectorized()) {
+        Kernels::RowBest row_at_min, row_at_max;
+        row_bounds[active_indices[i]] = Kernels::row_candidates(dists.data(), i1, active_indices.data() + i + 1,
+                                                                active_indices.size() - i - 1, alpha_min, alpha_max,
+                                                                row_at_min, row_at_max);
+        if (row_at_min.position != Kernels::no_position) {
+            long j_min = active_indices[i + 1 + row_at_min.position];
+            long j_max = active_indices[i + 1 + row_at_max.position];
+            if (at_min.improves(row_at_min.dist, row_at_min.slope, active_indices[i], j_min)) {
+                at_min.lf = dists[i1 + j_min].function();
+                at_min.indices = MergeCandidate(active_indices[i], j_min);
+                at_min.dist = row_at_min.dist;
+            }
+            if (at_max.improves(row_at_max.dist, row_at_max.slope, active_indices[i], j_max)) {
+                at_max.lf = dists[i1 + j_max].function();
+                at_max.indices = MergeCandidate(active_indices[i], j_max);
+                at_max.dist = row_at_max.dist;
+            }
+        }
+        return;
+    }
+    for (auto j = i + 1; j < active_indices.size(); j++) {
+        InterpolatedDistance const &f = dists[i1 + active_indices[j]];
+        dist_min = f.at(alpha_min);
+        dist_max = f.at(alpha_max);
+        if (at_min.improves(dist_min, f.slope(), active_indices[i], active_indices[j])) {
+            at_min.lf = f.function();
+            at_min.indices = MergeCandidate(active_indices[i], active_indices[j]);
+            at_min.dist = dist_min;
+        }
+        if (at_max.improves(dist_max, f.slope(), active_indices[i], active_indices[j])) {
+            at_max.lf = f.function();
+            at_max.indices = MergeCandidate(active_indices[i], active_indices[j]);
+            at_max.dist = dist_max;
+        }
+        row_min = std::min(row_min, std::min(dist_min, dist_max));
+    }
+    row_bounds[active_indices[i]] = row_min;
 }
 
 /**
- * Get the clusters and the resulting distance function that get merged for a certain alpha value with the distance
- * being (1-alpha) * lower_dist + alpha * upper_dist.
- * @param lower_dists
- * @param upper_dists
+ * Scans the rows [first, last) of the active clusters for the merge candidates at both ends of an alpha interval. Rows
+ * whose bound is above both current candidates cannot contain a better pair and are skipped.
+ * @param dists - the pairwise distance functions
  * @param active_indices
- * @param alpha
- * @param width
- * @return the next linear function distance(alpha) and the next merge clusters i and j
+ * @param first - position of the first row in active_indices
+ * @param last - position after the last row in active_indices
+ * @param skip - position of a row that was already scanned
+ * @param alpha_min - lower end of the interval
+ * @param alpha_max - upper end of the interval
+ * @param layout - the layout of the distance functions
+ * @param row_bounds - lower bounds of the rows' distances
+ * @param at_min - receives the best candidate for alpha_min
+ * @param at_max - receives the best candidate for alpha_max
  */
-std::pair<LinearFunction, MergeCandidate> find_merge_candidates(std::vector<double> const &lower_dists,
-                                                                std::vector<double> const &upper_dists,
-                                                                std::vector<long> const &active_indices, double alpha,
-                                                                size_t width) {
-    LinearFunction lf;
-    MergeCandidate indices;
-    double mindist = std::numeric_limits<double>::infinity();
-    double dist;
-    long i1, i2;
-    for (auto i = 0; i < active_indices.size(); i++) {
-        i1 = Helpers::get_reduced_matrix_outter_index(width, active_indices[i]);
-        for (auto j = i + 1; j < active_indices.size(); j++) {
-            i2 = i1 + active_indices[j];
-            dist = (1 - alpha) * lower_dists[i2] + alpha * upper_dists[i2];
-            if (dist < mindist) {
-                lf = LinearFunction(upper_dists[i2] - lower_dists[i2], lower_dists[i2]);
-                indices = MergeCandidate(active_indices[i], active_indices[j]);
-                mindist = dist;
-            } else if (dist == mindist) {
-                LinearFunction lf_new = LinearFunction(upper_dists[i2] - lower_dists[i2], lower_dists[i2]);
-                if (lf_new.a < lf.a) {
-                    indices = MergeCandidate(active_indices[i], active_indices[j]);
-                    mindist = dist;
-                    lf = lf_new;
-                }
-            }
+inline void find_merge_candidates(DistanceFunctions const &dists, std::vector<long> const &active_indices, size_t first,
+                                  size_t last, size_t skip, double alpha_min, double alpha_max,
+                                  DistanceLayout const &layout, std::vector<double> &row_bounds, BestMerge &at_min,
+                                  BestMerge &at_max) {
+    for (auto i = first; i < last; i++) {
+        double bound = row_bounds[active_indices[i]];
+        if (i != skip && (bound <= at_min.dist || bound <= at_max.dist)) {
+            find_merge_candidates_in_row(dists, active_indices, i, alpha_min, alpha_max, layout, row_bounds, at_min,
+                                         at_max);
         }
     }
-    return {lf, indices};
 }
 
 /**
- * Update the single linkage distances for merging clusters i and j where the distance don't include redundant values
- * @param dists - single linkage distances
- * @param active_indices - instaces of cluster that were not merged yet
- * @param i - first merged cluster
- * @param j - second merged cluster
- * @param width - number of points (width of pairwise distance matrix)
+ * Get the clusters and the resulting distance functions that get merged at both ends of an alpha interval with the
+ * distance being (1-alpha) * lower_dist + alpha * upper_dist. Both candidates are found in a single pass over the
+ * distance functions. The row with the smallest bound is scanned first, which usually excludes most other rows by their
+ * bounds. With more than one thread the remaining rows are split into ranges with equally many pairs whose results are
+ * reduced afterwards; since candidates are totally ordered the result matches the serial scan.
+ * @param dists - the pairwise distance functions
+ * @param active_indices
+ * @param alpha_min - lower end of the interval
+ * @param alpha_max - upper end of the interval
+ * @param layout - the layout of the distance functions
+ * @param row_bounds - lower bounds of the rows' distances, tightened for all scanned rows
+ * @param threads - the number of threads used for the scan
+ * @return the next linear function distance(alpha) and the next merge clusters i and j for alpha_min and alpha_max
+ */
+inline std::pair<std::pair<LinearFunction, MergeCandidate>, std::pair<LinearFunction, MergeCandidate> >
+find_merge_candidates(DistanceFunctions const &dists, std::vector<long> const &active_indices, double alpha_min,
+                      double alpha_max, DistanceLayout const &layout, std::vector<double> &row_bounds,
+                      size_t threads = 1) {
+    BestMerge at_min, at_max;
+    size_t seed = 0;
+    for (size_t i = 1; i + 1 < active_indices.size(); i++) {
+        if (row_bounds[active_indices[i]] < row_bounds[active_indices[seed]]) {
+            seed = i;
+        }
+    }
+    if (active_indices.size() > 1) {
+        find_merge_candidates_in_row(dists, active_indices, seed, alpha_min, alpha_max, layout, row_bounds, at_min,
+                                     at_max);
+    }
+    if (threads <= 1) {
+        find_merge_candidates(dists, active_indices, 0, active_indices.size(), seed, alpha_min, alpha_max, layout,
+                              row_bounds, at_min, at_max);
+    } else {
+        std::vector<size_t> bounds = Parallel::triangle_chunks(active_indices.size(), threads);
+        std::vector<BestMerge> mins(threads, at_min), maxs(threads, at_max);
+        Parallel::run_chunks(threads, [&](size_t c) {
+            find_merge_candidates(dists, active_indices, bounds[c], bounds[c + 1], seed, alpha_min, alpha_max, layout,
+                                  row_bounds, mins[c], maxs[c]);
+        });
+        for (size_t c = 0; c < threads; c++) {
+            at_min.offer(mins[c]);
+            at_max.offer(maxs[c]);
+        }
+    }
+    return {{at_min.lf, at_min.indices}, {at_max.lf, at_max.indices}};
+}
+
+/*!
+ * Nearest neighbour of a cluster for one value of alpha. It is unique if no other cluster has the same distance.
  */
-void
-merge_min_dists(std::vector<double> &dists, std::vector<long> const &active_indices, long i, long j, size_t width) {
-    long k, l;
-    for (auto active_index : active_indices) {
-        k = Helpers::get_reduced_matrix_index(width, std::min(i, active_index), std::max(i, active_index));
-        l = Helpers::get_reduced_matrix_index(width, std::min(j, active_index), std::max(j, active_index));
-        if (i != active_index) {
-            dists[k] = std::min(dists[k], dists[l]);
+struct NearestNeighbour {
+    double dist;
+    size_t position;
+    bool unique;
+
+    NearestNeighbour() : dist(std::numeric_limits<double>::infinity()), position(0), unique(false) {}
+
+    void offer(double d, size_t other) {
+        if (d < dist) {
+            dist = d;
+            position = other;
+            unique = true;
+        } else if (d == dist) {
+            unique = false;
+        }
+    }
+
+    void offer(NearestNeighbour const &other) {
+        if (other.dist < dist) {
+            *this = other;
+        } else if (other.dist == dist) {
+            unique = false;
         }
-        if (j != active_index) {
-            dists[l] = float_inf;
+    }
+};
+
+/**
+ * Finds the nearest neighbours of the active clusters at position [0, m) at both ends of an alpha interval among the
+ * pairs in the rows [first, last).
+ * @param dists - the pairwise distance functions
+ * @param active_indices
+ * @param first - position of the first row in active_indices
+ * @param last - position after the last row in active_indices
+ * @param alpha_min - lower end of the interval
+ * @param alpha_max - upper end of the interval
+ * @param layout - the layout of the distance functions
+ * @param at_min - receives the nearest neighbours at alpha_min, indexed by position in active_indices
+ * @param at_max - receives the nearest neighbours at alpha_max, indexed by position in active_indices
+ */
+inline void find_nearest_neighbours(DistanceFunctions const &dists, std::vector<long> const &active_indices,
+                                    size_t first, size_t last, double alpha_min, double alpha_max,
+                                    DistanceLayout const &layout, std::vector<NearestNeighbour> &at_min,
+                                    std::vector<NearestNeighbour> &at_max) {
+    for (auto i = first; i < last; i++) {
+        long i1 = layout.row_base(active_indices[i]);
+        for (auto j = i + 1; j < active_indices.size(); j++) {
+            InterpolatedDistance const &f = dists[i1 + active_indices[j]];
+            double dist_min = f.at(alpha_min);
+            double dist_max = f.at(alpha_max);
+            at_min[i].offer(dist_min, j);
+            at_min[j].offer(dist_min, i);
+            at_max[i].offer(dist_max, j);
+            at_max[j].offer(dist_max, i);
         }
     }
 }
 
 /**
- * Update the average linkage distances for merging clusters i and j where the distance don't include redundant values
- * @param dists - average linkage distances
- * @param cluster_sizes - the sized of all clusters
- * @param active_indices - instaces of cluster that were not merged yet
- * @param i - first merged cluster
- * @param j - second merged cluster
- * @param width - number of points (width of pairwise distance matrix)
+ * Finds all pairs of clusters that are each other's unique nearest neighbour at both ends of an alpha interval. As the
+ * distances are linear in alpha, they are mutual nearest neighbours for every alpha of the interval. For a reducible
+ * linkage such pairs are merged in every clustering of the interval, no matter when, and merging one of them keeps all
+ * others mutual nearest neighbours, so that all pairs can be merged at once without changing any resulting tree.
+ * @param dists - the pairwise distance functions
+ * @param active_indices
+ * @param alpha_min - lower end of the interval
+ * @param alpha_max - upper end of the interval
+ * @param layout - the layout of the distance functions
+ * @param threads - the number of threads used for the scan
+ * @return the certified merges, ordered by their first cluster
  */
-void merge_avg_dists(std::vector<double> &dists, std::vector<short> const &cluster_sizes,
-                     std::vector<long> const &active_indices,
-                     long i, long j, size_t width) {
-    long k, l;
-    for (auto active_index : active_indices) {
-        k = Helpers::get_reduced_matrix_index(width, std::min(i, active_index), std::max(i, active_index));
-        l = Helpers::get_reduced_matrix_index(width, std::min(j, active_index), std::max(j, active_index));
-        if (i != active_index) {
-            dists[k] =
-                    (cluster_sizes[i] * dists[k] + cluster_sizes[j] * dists[l]) / (cluster_sizes[i] + cluster_sizes[j]);
+inline std::vector<MergeCandidate> find_certified_merges(DistanceFunctions const &dists,
+                                                         std::vector<long> const &active_indices, double alpha_min,
+                                                         double alpha_max, DistanceLayout const &layout,
+                                                         size_t threads = 1) {
+    size_t m = active_indices.size();
+    std::vector<NearestNeighbour> at_min(m), at_max(m);
+    if (threads <= 1) {
+        find_nearest_neighbours(dists, active_indices, 0, m, alpha_min, alpha_max, layout, at_min, at_max);
+    } else {
+        // every task collects the neighbours of its pairs separately, they are combined afterwards
+        std::vector<size_t> bounds = Parallel::triangle_chunks(m, threads);
+        std::vector<std::vector<NearestNeighbour> > mins(threads), maxs(threads);
+        Parallel::run_chunks(threads, [&](size_t c) {
+            mins[c].resize(m);
+            maxs[c].resize(m);
+            find_nearest_neighbours(dists, active_indices, bounds[c], bounds[c + 1], alpha_min, alpha_max, layout,
+                                    mins[c], maxs[c]);
+        });
+        for (size_t c = 0; c < threads; c++) {
+            for (size_t i = 0; i < m; i++) {
+                at_min[i].offer(mins[c][i]);
+                at_max[i].offer(maxs[c][i]);
+            }
         }
-        if (i != active_index && j != active_index) {
-            dists[l] = float_inf;
+    }
+    std::vector<MergeCandidate> merges;
+    for (size_t i = 0; i < m; i++) {
+        size_t j = at_min[i].position;
+        if (j > i && at_min[i].unique && at_min[j].unique && at_min[j].position == i && at_max[i].unique &&
+            at_max[j].unique && at_max[i].position == j && at_max[j].position == i) {
+            merges.emplace_back(active_indices[i], active_indices[j]);
         }
     }
+    return merges;
 }
 
 /**
- * Update the complete linkage distances for merging clusters i and j where the distance don't include redundant values
- * @param dists - complete linkage distances
- * @param active_indices - instaces of cluster that were not merged yet
+ * Finds all pairs of clusters of a state that are each other's unique nearest neighbour at both ends of its interval.
+ * @param st - current state
+ * @param threads - the number of threads used for the scan
+ * @return the certified merges, ordered by their first cluster
+ */
+inline std::vector<MergeCandidate> find_certified_merges(State const &st, size_t threads = 1) {
+    return find_certified_merges(st.dists, st.active_indices, st.alpha_min, st.alpha_max, st.layout, threads);
+}
+
+/// update rule of the single linkage distance
+struct MinLinkage {
+    double operator()(double di, double dj) const { return std::min(di, dj); }
+};
+
+/// update rule of the complete linkage distance
+struct MaxLinkage {
+    double operator()(double di, double dj) const { return std::max(di, dj); }
+};
+
+/// update rule of the average linkage distance, weighted by the sizes of both merged clusters
+struct AvgLinkage {
+    int size_i;
+    int size_j;
+
+    double operator()(double di, double dj) const { return (size_i * di + size_j * dj) / (size_i + size_j); }
+};
+
+/**
+ * Updates the distance functions of cluster i to all other active clusters after merging cluster j into i. The lower
+ * (alpha = 0) and upper (alpha = 1) distances are updated by the linkage rules on their own, so that no rounding of
+ * the interpolation builds up over the merges. In the square layout rows i and j are read contiguously and every new
+ * function is mirrored into column i. The distances of cluster j are left untouched since j is no longer active
+ * afterwards. The bound of row i is recomputed from its new distances, the bounds of the rows above it can only
+ * decrease. Bounds of rows that lose their smallest distance to j stay valid and are tightened on the next scan of the
+ * row.
+ * @tparam Lower - update rule of the lower linkage
+ * @tparam Upper - update rule of the upper linkage
+ * @param st - current state
  * @param i - first merged cluster
  * @param j - second merged cluster
- * @param width - number of points (width of pairwise distance matrix)
+ * @param lower - the update rule for the lower distances
+ * @param upper - the update rule for the upper distances
+ * @param threads - the maximum number of threads, large merges are split into tasks of merge_task_updates updates
  */
-void
-merge_max_dists(std::vector<double> &dists, std::vector<long> const &active_indices, long i, long j, size_t width) {
-    long k, l;
-    for (auto active_index : active_indices) {
-        k = Helpers::get_reduced_matrix_index(width, std::min(i, active_index), std::max(i, active_index));
-        l = Helpers::get_reduced_matrix_index(width, std::min(j, active_index), std::max(j, active_index));
-        if (i != active_index) {
-            dists[k] = std::max(dists[k], dists[l]);
-        }
-        if (i != active_index && j != active_index) {
-            dists[l] = float_inf;
+template<typename Lower, typename Upper>
+inline void merge_dists(State &st, long i, long j, Lower lower, Upper upper, size_t threads = 1) {
+    DistanceFunctions &dists = st.dists;
+    DistanceLayout const &layout = st.layout;
+    std::vector<long> const &active_indices = st.active_indices;
+    std::vector<double> &row_bounds = st.row_bounds;
+    double alpha_min = st.alpha_min, alpha_max = st.alpha_max;
+    auto update = [lower, upper](InterpolatedDistance const &fi, InterpolatedDistance const &fj) {
+        return InterpolatedDistance(lower(fi.lower, fj.lower), upper(fi.upper, fj.upper));
+    };
+    auto update_range = [&](size_t first, size_t last) {
+        double row_i_min = std::numeric_limits<double>::infinity();
+        for (size_t a = first; a < last; a++) {
+            long active_index = active_indices[a];
+            if (active_index == i || active_index == j) {
+                continue;
+            }
+            InterpolatedDistance value;
+            if (layout.is_square()) {
+                InterpolatedDistance *row_i = dists.data() + i * layout.stride;
+                value = update(row_i[active_index], dists[j * layout.stride + active_index]);
+                row_i[active_index] = value;
+                dists[active_index * layout.stride + i] = value;
+            } else {
+                long k = layout.index(i, active_index);
+                value = update(dists[k], dists[layout.index(j, active_index)]);
+                dists[k] = value;
+            }
+            double bound = std::min(value.at(alpha_min), value.at(alpha_max));
+            if (active_index > i) {
+                row_i_min = std::min(row_i_min, bound);
+            } else {
+                row_bounds[active_index] = std::min(row_bounds[active_index], bound);
+            }
         }
+        return row_i_min;
+    };
+    size_t tasks = std::min(threads, active_indices.size() / merge_task_updates);
+    if (tasks <= 1) {
+        row_bounds[i] = update_range(0, active_indices.size());
+    } else {
+        // every task writes the distances and bounds of a disjoint set of clusters
+        size_t chunk = (active_indices.size() + tasks - 1) / tasks;
+        std::vector<double> row_i_mins(tasks);
+        Parallel::run_chunks(tasks, [&](size_t c) {
+            row_i_mins[c] = update_range(c * chunk, std::min(active_indices.size(), (c + 1) * chunk));
+        });
+        row_bounds[i] = *std::min_element(row_i_mins.begin(), row_i_mins.end());
     }
 }
 
@@ -142,14 +391,13 @@ merge_max_dists(std::vector<double> &dists, std::vector<long> const &active_indi
  * @param st - current state
  * @param i - first merged cluster
  * @param j - second merged cluster
- * @param width - number of points (width of pairwise distance matrix)
+ * @param threads - the maximum number of threads for the distance updates
  */
-void merge_clusters(SC_State &st, long i, long j, size_t width) {
-    merge_min_dists(st.lower_dists, st.active_indices, i, j, width);
-    merge_max_dists(st.upper_dists, st.active_indices, i, j, width);
+inline void merge_clusters(SC_State &st, long i, long j, size_t threads = 1) {
+    merge_dists(st, i, j, MinLinkage(), MaxLinkage(), threads);
     st.active_indices.erase(std::remove(st.active_indices.begin(), st.active_indices.end(), j),
                             st.active_indices.end());
-    st.nodes[i] = new ClusterNode(st.nodes[i], st.nodes[j], st.nodes[i]->counts + st.nodes[j]->counts, true);
+    st.nodes[i] = new ClusterNode(st.nodes[i], st.nodes[j]);
 }
 
 /**
@@ -157,15 +405,14 @@ void merge_clusters(SC_State &st, long i, long j, size_t width) {
  * @param st - current state
  * @param i - first merged cluster
  * @param j - second merged cluster
- * @param width - number of points (width of pairwise distance matrix)
+ * @param threads - the maximum number of threads for the distance updates
  */
-void merge_clusters(SA_State &st, long i, long j, size_t width) {
-    merge_min_dists(st.lower_dists, st.active_indices, i, j, width);
-    merge_avg_dists(st.upper_dists, st.cluster_sizes, st.active_indices, i, j, width);
+inline void merge_clusters(SA_State &st, long i, long j, size_t threads = 1) {
+    merge_dists(st, i, j, MinLinkage(), AvgLinkage{st.cluster_sizes[i], st.cluster_sizes[j]}, threads);
     st.active_indices.erase(std::remove(st.active_indices.begin(), st.active_indices.end(), j),
                             st.active_indices.end());
     st.cluster_sizes[i] = st.cluster_sizes[i] + st.cluster_sizes[j];
-    st.nodes[i] = new ClusterNode(st.nodes[i], st.nodes[j], st.nodes[i]->counts + st.nodes[j]->counts, true);
+    st.nodes[i] = new ClusterNode(st.nodes[i], st.nodes[j]);
 }
 
 /**
@@ -173,15 +420,14 @@ void merge_clusters(SA_State &st, long i, long j, size_t width) {
  * @param st - current state
  * @param i - first merged cluster
  * @param j - second merged cluster
- * @param width - number of points (width of pairwise distance matrix)
+ * @param threads - the maximum number of threads for the distance updates
  */
-void merge_clusters(AC_State &st, long i, long j, size_t width) {
-    merge_avg_dists(st.lower_dists, st.cluster_sizes, st.active_indices, i, j, width);
-    merge_max_dists(st.upper_dists, st.active_indices, i, j, width);
+inline void merge_clusters(AC_State &st, long i, long j, size_t threads = 1) {
+    merge_dists(st, i, j, AvgLinkage{st.cluster_sizes[i], st.cluster_sizes[j]}, MaxLinkage(), threads);
     st.active_indices.erase(std::remove(st.active_indices.begin(), st.active_indices.end(), j),
                             st.active_indices.end());
     st.cluster_sizes[i] = st.cluster_sizes[i] + st.cluster_sizes[j];
-    st.nodes[i] = new ClusterNode(st.nodes[i], st.nodes[j], st.nodes[i]->counts + st.nodes[j]->counts, true);
+    st.nodes[i] = new ClusterNode(st.nodes[i], st.nodes[j]);
 }
 
 #endif /* merge_h */
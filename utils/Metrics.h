@@ -0,0 +1,346 @@
+#ifndef Metrics_h
+#define Metrics_h
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "AlignedAllocator.h"
+
+#include "Isa.h"
+
+#if ISA_X86
+#include <immintrin.h>
+#endif
+
+/*!
+ * Metric policies of the initial distances and the kernels that compute all distances of one point with them. A policy
+ * prepares one value per point (e.g. its norm), accumulates the dimensions of a pair one after another and finishes the
+ * sum to the distance. The vector kernels compute one pair per lane and accumulate its dimensions in the same order as
+ * the scalar code, so every instruction set yields the same distances as the functions of DistanceFunction.
+ */
+namespace Metrics {
+
+    /*!
+     * Euclidean distance (L2 norm), like DistanceFunction::euclidean_dist. Interleaved channels of e.g. RGB pixels
+     * need no policy of their own, the sum over all pixels and channels is the one over the flat features.
+     */
+    struct Euclidean {
+        static double prepare(double const *x, size_t dims) { return 0.0; }
+
+        static double accumulate(double sum, double a, double b) {
+            double d = a - b;
+            return sum + d * d;
+        }
+
+        static double finish(double sum, double prepared_a, double prepared_b) { return std::sqrt(sum); }
+
+#if ISA_X86
+
+        __attribute__((target("avx2")))
+        static __m256d accumulate(__m256d sum, __m256d a, __m256d b) {
+            __m256d d = _mm256_sub_pd(a, b);
+            return _mm256_add_pd(sum, _mm256_mul_pd(d, d));
+        }
+
+        __attribute__((target("avx2")))
+        static __m256d finish(__m256d sum, __m256d prepared_a, __m256d prepared_b) { return _mm256_sqrt_pd(sum); }
+
+        __attribute__((target("avx512f")))
+        static __m512d accumulate(__m512d sum, __m512d a, __m512d b) {
+            __m512d d = _mm512_sub_pd(a, b);
+            return _mm512_add_pd(sum, _mm512_mul_pd(d, d));
+        }
+
+        __attribute__((target("avx512f")))
+        static __m512d finish(__m512d sum, __m512d prepared_a, __m512d prepared_b) { return _mm512_sqrt_pd(sum); }
+
+#endif
+    };
+
+    /*!
+     * Squared Euclidean distance, which saves the square root but is no metric.
+     */
+    struct SquaredEuclidean : Euclidean {
+        static double finish(double sum, double prepared_a, double prepared_b) { return sum; }
+
+#if ISA_X86
+
+        __attribute__((target("avx2")))
+        static __m256d finish(__m256d sum, __m256d prepared_a, __m256d prepared_b) { return sum; }
+
+        __attribute__((target("avx512f")))
+        static __m512d finish(__m512d sum, __m512d prepared_a, __m512d prepared_b) { return sum; }
+
+#endif
+    };
+
+    /*!
+     * Cosine distance (i.e. the angle between two vectors), like DistanceFunction::cosine_dist but with the norm of
+     * every point computed once and the cosine clamped to [-1, 1], whose rounding would otherwise turn the angle of
+     * nearly parallel vectors into NaN. A zero vector has no direction, it is taken as orthogonal to all other vectors
+     * (angle pi / 2) and identical to other zero vectors.
+     */
+    struct Cosine {
+        static double prepare(double const *x, size_t dims) {
+            double norm = 0.0;
+            for (size_t k = 0; k < dims; k++) {
+                norm += x[k] * x[k];
+            }
+            return std::sqrt(norm);
+        }
+
+        static double accumulate(double sum, double a, double b) { return sum + a * b; }
+
+        static double finish(double sum, double prepared_a, double prepared_b) {
+            if (prepared_a == 0.0 || prepared_b == 0.0) {
+                return prepared_a == prepared_b ? 0.0 : std::acos(0.0);
+            }
+            double cosine = sum / prepared_a / prepared_b;
+            return std::acos(cosine > 1.0 ? 1.0 : cosine < -1.0 ? -1.0 : cosine);
+        }
+
+#if ISA_X86
+
+        __attribute__((target("avx2")))
+        static __m256d accumulate(__m256d sum, __m256d a, __m256d b) {
+            return _mm256_add_pd(sum, _mm256_mul_pd(a, b));
+        }
+
+        __attribute__((target("avx2")))
+        static __m256d finish(__m256d sum, __m256d prepared_a, __m256d prepared_b) {
+            // the angle is a scalar call per lane anyway
+            alignas(32) double lanes[3][4];
+            _mm256_store_pd(lanes[0], sum);
+            _mm256_store_pd(lanes[1], prepared_a);
+            _mm256_store_pd(lanes[2], prepared_b);
+            for (size_t lane = 0; lane < 4; lane++) {
+                lanes[0][lane] = finish(lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+            }
+            return _mm256_load_pd(lanes[0]);
+        }
+
+        __attribute__((target("avx512f")))
+        static __m512d accumulate(__m512d sum, __m512d a, __m512d b) {
+            return _mm512_add_pd(sum, _mm512_mul_pd(a, b));
+        }
+
+        __attribute__((target("avx512f")))
+        static __m512d finish(__m512d sum, __m512d prepared_a, __m512d prepared_b) {
+            // the angle is a scalar call per lane anyway
+            alignas(64) double lanes[3][8];
+            _mm512_store_pd(lanes[0], sum);
+            _mm512_store_pd(lanes[1], prepared_a);
+            _mm512_store_pd(lanes[2], prepared_b);
+            for (size_t lane = 0; lane < 8; lane++) {
+                lanes[0][lane] = finish(lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+            }
+            return _mm512_load_pd(lanes[0]);
+        }
+
+#endif
+    };
+
+    /*!
+     * Manhattan distance (L1 norm).
+     */
+    struct Manhattan {
+        static double prepare(double const *x, size_t dims) { return 0.0; }
+
+        static double accumulate(double sum, double a, double b) { return sum + std::fabs(a - b); }
+
+        static double finish(double sum, double prepared_a, double prepared_b) { return sum; }
+
+#if ISA_X86
+
+        __attribute__((target("avx2")))
+        static __m256d accumulate(__m256d sum, __m256d a, __m256d b) {
+            return _mm256_add_pd(sum, _mm256_andnot_pd(_mm256_set1_pd(-0.0), _mm256_sub_pd(a, b)));
+        }
+
+        __attribute__((target("avx2")))
+        static __m256d finish(__m256d sum, __m256d prepared_a, __m256d prepared_b) { return sum; }
+
+        __attribute__((target("avx512f")))
+        static __m512d accumulate(__m512d sum, __m512d a, __m512d b) {
+            return _mm512_add_pd(sum, _mm512_abs_pd(_mm512_sub_pd(a, b)));
+        }
+
+        __attribute__((target("avx512f")))
+        static __m512d finish(__m512d sum, __m512d prepared_a, __m512d prepared_b) { return sum; }
+
+#endif
+    };
+
+    /// points per block of the interleaved features, the widest vector of the kernels
+    const size_t block_points = 8;
+
+    /*!
+     * The feature vectors of all points in two orders: row-major for the scalar kernel and in blocks of block_points
+     * points for the vector kernels, where each block holds the first dimension of its points, then the second one
+     * and so on. A vector kernel thereby loads one dimension of several points at once and reads a block from front to
+     * back. The last block and the prepared values are padded with zeros.
+     */
+    struct PackedPoints {
+        size_t count;
+        size_t dims;
+        /// the number of points padded to whole blocks
+        size_t stride;
+        std::vector<double> rows;
+        std::vector<double, AlignedAllocator<double, 64> > blocks;
+        std::vector<double> prepared;
+    };
+
+    /**
+     * Packs the feature vectors for the kernels of a metric.
+     * @tparam M - the metric policy
+     * @tparam T - the numeric feature type
+     * @param feature_vectors - a vector of all feature vectors (i.e. points)
+     * @return the packed points with their prepared values
+     */
+    template<typename M, typename T>
+    PackedPoints pack(const std::vector<std::vector<T> > &feature_vectors) {
+        PackedPoints points;
+        points.count = feature_vectors.size();
+        points.dims = feature_vectors.empty() ? 0 : feature_vectors[0].size();
+        points.stride = (points.count + block_points - 1) / block_points * block_points;
+        points.rows.reserve(points.count * points.dims);
+        for (std::vector<T> const &point : feature_vectors) {
+            points.rows.insert(points.rows.end(), point.begin(), point.end());
+        }
+        points.prepared.assign(points.stride, 0.0);
+        for (size_t p = 0; p < points.count; p++) {
+            points.prepared[p] = M::prepare(&points.rows[p * points.dims], points.dims);
+        }
+        if (Isa::level() != ISA_SSE2) {
+            points.blocks.assign(points.dims * points.stride, 0.0);
+            for (size_t p = 0; p < points.count; p++) {
+                double *block = &points.blocks[p / block_points * block_points * points.dims];
+                for (size_t k = 0; k < points.dims; k++) {
+                    block[k * block_points + p % block_points] = points.rows[p * points.dims + k];
+                }
+            }
+        }
+        return points;
+    }
+
+    /// points whose rows a kernel computes together, so that every loaded block serves all of them
+    const size_t tile_rows = 4;
+
+    /**
+     * Computes the distances of consecutive points to all later points.
+     * @tparam M - the metric policy
+     * @param points - the packed points
+     * @param first - the first point
+     * @param rows - the number of points, at most tile_rows
+     * @param out - receives the distance of point first + r to point j > first + r at position r * points.stride + j
+     */
+    template<typename M>
+    inline void row_dists_sse2(PackedPoints const &points, size_t first, size_t rows, double *out) {
+        for (size_t i = first; i < first + rows; i++) {
+            double const *a = &points.rows[i * points.dims];
+            double *row = out + (i - first) * points.stride;
+            for (size_t j = i + 1; j < points.count; j++) {
+                double const *b = &points.rows[j * points.dims];
+                double sum = 0.0;
+                for (size_t k = 0; k < points.dims; k++) {
+                    sum = M::accumulate(sum, a[k], b[k]);
+                }
+                row[j] = M::finish(sum, points.prepared[i], points.prepared[j]);
+            }
+        }
+    }
+
+#if ISA_X86
+
+    template<typename M>
+    __attribute__((target("avx2")))
+    inline void row_dists_avx2(PackedPoints const &points, size_t first, size_t rows, double *out) {
+        // missing rows of the tile repeat the last point, the block of the first point is computed whole and all
+        // pairs up to the point of a row are not used
+        double const *a[tile_rows];
+        for (size_t r = 0; r < tile_rows; r++) {
+            a[r] = &points.rows[(first + std::min(r, rows - 1)) * points.dims];
+        }
+        for (size_t j = (first + 1) / block_points * block_points; j < points.count; j += block_points) {
+            double const *block = &points.blocks[j * points.dims];
+            __m256d sums[tile_rows][2];
+            for (size_t r = 0; r < tile_rows; r++) {
+                sums[r][0] = _mm256_setzero_pd();
+                sums[r][1] = _mm256_setzero_pd();
+            }
+            for (size_t k = 0; k < points.dims; k++) {
+                __m256d low = _mm256_load_pd(block + k * block_points);
+                __m256d high = _mm256_load_pd(block + k * block_points + 4);
+                for (size_t r = 0; r < tile_rows; r++) {
+                    __m256d value = _mm256_set1_pd(a[r][k]);
+                    sums[r][0] = M::accumulate(sums[r][0], value, low);
+                    sums[r][1] = M::accumulate(sums[r][1], value, high);
+                }
+            }
+            __m256d prepared_low = _mm256_loadu_pd(&points.prepared[j]);
+            __m256d prepared_high = _mm256_loadu_pd(&points.prepared[j + 4]);
+            for (size_t r = 0; r < rows; r++) {
+                __m256d prepared_a = _mm256_set1_pd(points.prepared[first + r]);
+                double *row = out + r * points.stride + j;
+                _mm256_storeu_pd(row, M::finish(sums[r][0], prepared_a, prepared_low));
+                _mm256_storeu_pd(row + 4, M::finish(sums[r][1], prepared_a, prepared_high));
+            }
+        }
+    }
+
+    template<typename M>
+    __attribute__((target("avx512f")))
+    inline void row_dists_avx512(PackedPoints const &points, size_t first, size_t rows, double *out) {
+        double const *a[tile_rows];
+        for (size_t r = 0; r < tile_rows; r++) {
+            a[r] = &points.rows[(first + std::min(r, rows - 1)) * points.dims];
+        }
+        for (size_t j = (first + 1) / block_points * block_points; j < points.count; j += block_points) {
+            double const *block = &points.blocks[j * points.dims];
+            __m512d sums[tile_rows];
+            for (size_t r = 0; r < tile_rows; r++) {
+                sums[r] = _mm512_setzero_pd();
+            }
+            for (size_t k = 0; k < points.dims; k++) {
+                __m512d values = _mm512_load_pd(block + k * block_points);
+                for (size_t r = 0; r < tile_rows; r++) {
+                    sums[r] = M::accumulate(sums[r], _mm512_set1_pd(a[r][k]), values);
+                }
+            }
+            __m512d prepared_b = _mm512_loadu_pd(&points.prepared[j]);
+            for (size_t r = 0; r < rows; r++) {
+                _mm512_storeu_pd(out + r * points.stride + j,
+                                 M::finish(sums[r], _mm512_set1_pd(points.prepared[first + r]), prepared_b));
+            }
+        }
+    }
+
+#endif
+
+    /**
+     * Computes the distances of consecutive points to all later points with the selected instruction set.
+     * @tparam M - the metric policy
+     * @param points - the packed points
+     * @param first - the first point
+     * @param rows - the number of points, at most tile_rows
+     * @param out - receives the distance of point first + r to point j > first + r at position r * points.stride + j
+     */
+    template<typename M>
+    inline void row_dists(PackedPoints const &points, size_t first, size_t rows, double *out) {
+#if ISA_X86
+        if (Isa::level() == ISA_AVX512) {
+            row_dists_avx512<M>(points, first, rows, out);
+            return;
+        }
+        if (Isa::level() == ISA_AVX2) {
+            row_dists_avx2<M>(points, first, rows, out);
+            return;
+        }
+#endif
+        row_dists_sse2<M>(points, first, rows, out);
+    }
+}
+
+#endif /* Metrics_h */
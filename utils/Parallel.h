@@ -0,0 +1,56 @@
+#ifndef Parallel_h
+#define Parallel_h
+
+#include <cstddef>
+#include <future>
+#include <vector>
+
+namespace Parallel {
+
+    /**
+     * Splits the rows of a strictly upper triangular matrix, in which row r holds n - 1 - r entries, into contiguous
+     * ranges that contain about the same number of entries.
+     * @param n - the number of rows
+     * @param chunks - the number of ranges
+     * @return chunks + 1 boundaries, range c covers the rows [bounds[c], bounds[c + 1])
+     */
+    inline std::vector<size_t> triangle_chunks(size_t n, size_t chunks) {
+        std::vector<size_t> bounds(chunks + 1, n);
+        bounds[0] = 0;
+        double total = 0.5 * (double) n * (double) (n - (n > 0 ? 1 : 0));
+        double seen = 0;
+        size_t row = 0;
+        for (size_t c = 1; c < chunks; c++) {
+            double target = total * (double) c / (double) chunks;
+            while (row < n && seen < target) {
+                seen += (double) (n - 1 - row);
+                row++;
+            }
+            bounds[c] = row;
+        }
+        return bounds;
+    }
+
+    /**
+     * Runs task(c) for every chunk c in [0, chunks). All chunks but the first are run as separate tasks, the first one
+     * on the calling thread. Returns after all chunks are done.
+     * @tparam Task - callable taking the chunk index
+     * @param chunks - the number of chunks
+     * @param task - the work of one chunk
+     */
+    template<typename Task>
+    inline void run_chunks(size_t chunks, Task task) {
+        std::vector<std::future<void> > futures;
+        for (size_t c = 1; c < chunks; c++) {
+            futures.push_back(std::async(std::launch::async, [&task, c]() { task(c); }));
+        }
+        if (chunks > 0) {
+            task(0);
+        }
+        for (std::future<void> &future : futures) {
+            future.get();
+        }
+    }
+}
+
+#endif /* Parallel_h */
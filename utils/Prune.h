@@ -1,52 +1,136 @@
 #ifndef Prune_h
 #define Prune_h
 
-#include <map>
+#include <algorithm>
+#include <future>
+#include <limits>
+#include <vector>
 
 #include "CostFunction.h"
 
 #include "ClusterNode.h"
+#include "NodeStore.h"
+#include "Objective.h"
 #include "Pruning.h"
 
+/// subtrees whose children both have at least this many leaves evaluate the left child as a separate task
+const int prune_task_leaves = 4096;
+
 /**
- * Get the optimal prunings for a hierarchical clustering (i.e. pruning for majority distance)
- * @param node - the root node
+ * Combines the optimal prunings of the two children of a node into the optimal prunings of the node (min-plus
+ * convolution of both rows). Entries for more clusters than leaves stay infinite.
+ * @param majority - the majority cost of the parent node, i.e. the cost of the pruning into one cluster
+ * @param left - optimal pruning costs of the left child, indexed by the number of clusters
+ * @param left_leaves - number of leaves below the left child
+ * @param right - optimal pruning costs of the right child, indexed by the number of clusters
+ * @param right_leaves - number of leaves below the right child
  * @param max_k - the amount of target clusters
- * @return a map matching amount of clusters to optimal prunings
+ * @param out - output row of max_k + 1 entries
  */
-inline std::map<int, Pruning> prune(ClusterNode const &node, size_t max_k)
+inline void combine_prunings(double majority, double const *left, int left_leaves, double const *right,
+                             int right_leaves, size_t max_k, double *out)
 {
-    std::map<int, Pruning> opt_prunings;
-    opt_prunings.insert( std::pair<int,Pruning>(1,Pruning(CostFunction::majority_cost(node))) );
-
-    if(node.has_children)
+    const double inf = std::numeric_limits<double>::infinity();
+    auto cap = std::min<size_t>(max_k, (size_t) (left_leaves + right_leaves));
+    out[1] = majority;
+    for(size_t k = 2; k <= max_k; k++)
     {
-        std::map<int, Pruning> left_opt_prunings = prune(*node.left, max_k);
-        std::map<int, Pruning> right_opt_prunings = prune(*node.right, max_k);
-
-        for(auto k = 2; k <= max_k; k++)
+        double best = inf;
+        if(k <= cap)
         {
-            Pruning best_k_pruning = Pruning(std::numeric_limits<double>::infinity());
-            for(int left_k = 1; left_k <= k-1; left_k++)
+            auto lo = (int) std::max<long>(1, (long) k - right_leaves);
+            auto hi = (int) std::min<long>(left_leaves, (long) k - 1);
+            for(int left_k = lo; left_k <= hi; left_k++)
             {
-                int right_k = k - left_k;
-                if(left_opt_prunings.count( left_k ) != 0 && right_opt_prunings.count( right_k ) != 0)
-                {
-                    Pruning left_opt = left_opt_prunings.find(left_k)->second;
-                    Pruning right_opt = right_opt_prunings.find(right_k)->second;
-                    Pruning pruning = Pruning(left_opt.cost + right_opt.cost);
-                    if(pruning.cost < best_k_pruning.cost)
-                    {
-                        best_k_pruning = pruning;
-                    }
-                }
+                double cost = left[left_k] + right[k - left_k];
+                best = cost < best ? cost : best;
             }
-            opt_prunings.insert( std::pair<int, Pruning>(k, best_k_pruning) );
+        }
+        out[k] = best;
+    }
+}
+
+/**
+ * Calculates the optimal majority prunings of all nodes in the subtree rooted at node. The subtree occupies the
+ * contiguous index range [node, store.subtree_end(node)), which is processed by one linear reverse sweep. Subtrees whose
+ * children are both large evaluate the left child as a separate task, which writes to a disjoint range of rows.
+ * @param store - the clustering tree
+ * @param node - index of the subtree's root
+ * @param max_k - the amount of target clusters
+ * @param rows - n_nodes x (max_k + 1) matrix, row i receives the optimal prunings of node i
+ * @param leaves - receives the number of leaves below each node
+ */
+inline void prune_subtree(NodeStore const &store, uint32_t node, size_t max_k, double *rows, int *leaves)
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    size_t width = max_k + 1;
+
+    if(store.has_children(node) && store.leaf_count(store.left[node]) >= prune_task_leaves &&
+       store.leaf_count(store.right[node]) >= prune_task_leaves)
+    {
+        std::future<void> left_task = std::async(std::launch::async, [&store, node, max_k, rows, leaves]() {
+            prune_subtree(store, store.left[node], max_k, rows, leaves);
+        });
+        prune_subtree(store, store.right[node], max_k, rows, leaves);
+        left_task.get();
+        uint32_t l = store.left[node], r = store.right[node];
+        combine_prunings(CostFunction::majority_cost(store, node), rows + l * width, leaves[l], rows + r * width,
+                         leaves[r], max_k, rows + node * width);
+        leaves[node] = leaves[l] + leaves[r];
+        return;
+    }
+
+    for(uint32_t i = store.subtree_end(node); i-- > node;)
+    {
+        double *row = rows + i * width;
+        if(store.has_children(i))
+        {
+            uint32_t l = store.left[i], r = store.right[i];
+            combine_prunings(CostFunction::majority_cost(store, i), rows + l * width, leaves[l], rows + r * width,
+                             leaves[r], max_k, row);
+            leaves[i] = leaves[l] + leaves[r];
+        }
+        else
+        {
+            std::fill(row, row + width, inf);
+            row[1] = CostFunction::majority_cost(store, i);
+            leaves[i] = store.leaf_count(i);
         }
     }
+}
+
+/**
+ * Get the optimal prunings for a hierarchical clustering (i.e. pruning for majority distance)
+ * @param store - the clustering tree
+ * @param max_k - the amount of target clusters
+ * @return a vector matching amount of clusters (index 1 to max_k) to optimal prunings, entries for more clusters than
+ * points are infinite
+ */
+inline std::vector<Pruning> prune(NodeStore const &store, size_t max_k)
+{
+    std::vector<double> rows(store.size() * (max_k + 1));
+    std::vector<int> leaves(store.size());
+    prune_subtree(store, 0, max_k, rows.data(), leaves.data());
+    std::vector<Pruning> opt_prunings(max_k + 1, Pruning(std::numeric_limits<double>::infinity()));
+    for(size_t k = 1; k <= max_k; k++)
+    {
+        opt_prunings[k] = Pruning(rows[k]);
+    }
     return opt_prunings;
 }
 
+/**
+ * Get the optimal prunings for a hierarchical clustering (i.e. pruning for majority distance)
+ * @param node - the root node
+ * @param max_k - the amount of target clusters
+ * @return a vector matching amount of clusters (index 1 to max_k) to optimal prunings, entries for more clusters than
+ * points are infinite
+ */
+inline std::vector<Pruning> prune(ClusterNode const &node, size_t max_k)
+{
+    return prune(NodeStore::from_tree(node), max_k);
+}
+
 /**
  * Get all possible prunings for a node into k clusters.
  * @tparam T - the type indicating the number of clusters
@@ -97,6 +181,79 @@ std::vector<std::vector<ClusterNode> > all_prunings(ClusterNode const &node, T k
     }
 }
 
+/**
+ * Get all possible prunings of a node of a node store into k clusters.
+ * @param store - the clustering tree
+ * @param node - index of the node containing all clusters
+ * @param k - number of clusters
+ * @return all possible prunings of the node into k clusters, each given by the indices of its clusters
+ */
+inline std::vector<std::vector<uint32_t> > all_prunings(NodeStore const &store, uint32_t node, size_t k)
+{
+    std::vector<std::vector<uint32_t> > prunings;
+    if(k == 1)
+    {
+        prunings.emplace_back(1, node);
+    }
+    else if(store.has_children(node))
+    {
+        for(size_t left_k = 1; left_k < k; left_k++)
+        {
+            std::vector<std::vector<uint32_t> > left_prunings = all_prunings(store, store.left[node], left_k);
+            if(left_prunings.empty())
+            {
+                continue;
+            }
+            std::vector<std::vector<uint32_t> > right_prunings = all_prunings(store, store.right[node], k - left_k);
+            for(const std::vector<uint32_t> &vec_l : left_prunings)
+            {
+                for(const std::vector<uint32_t> &vec_r : right_prunings)
+                {
+                    std::vector<uint32_t> pruning(vec_l);
+                    pruning.insert(pruning.end(), vec_r.begin(), vec_r.end());
+                    prunings.push_back(pruning);
+                }
+            }
+        }
+    }
+    return prunings;
+}
+
+/**
+ * Find the best pruning (i.e. with the lowest hamming distance) of a clustering tree into k clusters
+ * @param store - the clustering tree
+ * @param k - amount of target clusters
+ * @param solver - assignment solver whose workspace is reused between calls
+ * @return the optimal pruning (i.e. hamming cost) of the tree into k clusters
+ */
+inline Pruning best_pruning(NodeStore const &store, size_t k, AssignmentSolver &solver)
+{
+    std::vector<std::vector<uint32_t> > prunings = all_prunings(store, 0, k);
+    std::vector<double> costs = CostFunction::hamming_costs(store, prunings, solver);
+    double best_cost = std::numeric_limits<double>::infinity();
+    for(double cost : costs)
+    {
+        if(cost < best_cost)
+        {
+            best_cost = cost;
+        }
+    }
+    return {best_cost};
+}
+
+/**
+ * Find the best pruning (i.e. with the lowest hamming distance) of a node into k clusters
+ * @tparam T - type indicating the number of clusters
+ * @param node - contains all clusters
+ * @param k - amount of target clusters
+ * @param solver - assignment solver whose workspace is reused between calls
+ * @return the optimal pruning (i.e. hamming cost) of a node into k clusters
+ */
+template <typename T>
+Pruning best_pruning(ClusterNode const &node, T k, AssignmentSolver &solver) {
+    return best_pruning(NodeStore::from_tree(node), (size_t) k, solver);
+}
+
 /**
  * Find the best pruning (i.e. with the lowest hamming distance) of a node into k clusters
  * @tparam T - type indicating the number of clusters
@@ -106,18 +263,41 @@ std::vector<std::vector<ClusterNode> > all_prunings(ClusterNode const &node, T k
  */
 template <typename T>
 Pruning best_pruning(ClusterNode const &node, T k) {
-    std::vector<std::vector<ClusterNode> > prunings = all_prunings(node, k);
-    std::vector<ClusterNode> best_pruning = prunings[0];
-    double best_cost = std::numeric_limits<double>::infinity();
-    double cost;
-    for(const std::vector<ClusterNode> &nodes : prunings) {
-        cost = CostFunction::hamming_cost(nodes);
-        if(cost < best_cost) {
-            best_pruning = nodes;
-            best_cost = cost;
+    AssignmentSolver solver;
+    return best_pruning(node, k, solver);
+}
+
+/**
+ * Scores a clustering tree under several objectives at once. All majority objectives share one pruning table that is
+ * filled up to their largest k, the hamming objectives solve their assignment problems on the same solver.
+ * @param store - the clustering tree
+ * @param objectives - the cost functions and amounts of target clusters, k = 0 uses the number of labels
+ * @param solver - assignment solver whose workspace is reused between calls
+ * @return the (not normalized) cost of the tree under each objective
+ */
+inline std::vector<double> objective_costs(NodeStore const &store, std::vector<Objective> const &objectives,
+                                           AssignmentSolver &solver)
+{
+    size_t max_majority_k = 0;
+    for(Objective const &objective : objectives)
+    {
+        if(objective.majority)
+        {
+            max_majority_k = std::max(max_majority_k, objective.k > 0 ? objective.k : store.k);
         }
     }
-    return {best_cost};
+    std::vector<Pruning> majority_prunings;
+    if(max_majority_k > 0)
+    {
+        majority_prunings = prune(store, max_majority_k);
+    }
+    std::vector<double> costs;
+    for(Objective const &objective : objectives)
+    {
+        size_t k = objective.k > 0 ? objective.k : store.k;
+        costs.push_back(objective.majority ? majority_prunings[k].cost : best_pruning(store, k, solver).cost);
+    }
+    return costs;
 }
 
 #endif /* Prune_h */
@@ -0,0 +1,402 @@
+#ifndef SparseLinkage_h
+#define SparseLinkage_h
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "DistanceFunction.h"
+#include "Instersection.h"
+#include "LinearFunction.h"
+#include "MergeCandidate.h"
+#include "SparseState.h"
+#include "SplitState.h"
+
+#include "Clustering.h"
+#include "Merge.h"
+
+/**
+ * Finds the position of the known distance to a cluster in an adjacency row.
+ * @param row - the known distances of a cluster, ordered by the other cluster
+ * @param cluster - the other cluster
+ * @return the position of the distance to cluster, or of the first distance to a later cluster if it is unknown
+ */
+inline SparseRow::const_iterator find_edge(SparseRow const &row, long cluster) {
+    return std::lower_bound(row.begin(), row.end(), cluster,
+                            [](SparseEdge const &edge, long c) { return edge.cluster < c; });
+}
+
+inline SparseRow::iterator find_edge(SparseRow &row, long cluster) {
+    return std::lower_bound(row.begin(), row.end(), cluster,
+                            [](SparseEdge const &edge, long c) { return edge.cluster < c; });
+}
+
+/**
+ * Checks whether a known distance covers all point pairs of both clusters, i.e. is the exact linkage.
+ * @param st - current state
+ * @param i - the cluster whose row holds the distance
+ * @param edge - the known distance
+ * @return true if the distance is exact
+ */
+inline bool is_complete(SparseSC_State const &st, long i, SparseEdge const &edge) {
+    return edge.known == (long) (st.members[i].size() * st.members[edge.cluster].size());
+}
+
+/**
+ * Scans the known distances of cluster a to all later clusters for the merge candidates at both ends of the state's
+ * interval and tightens the row's bound to the smallest of these distances within the interval.
+ * @param st - current state
+ * @param a - the cluster of the row
+ * @param at_min - receives the best candidate for alpha_min
+ * @param at_max - receives the best candidate for alpha_max
+ */
+inline void find_merge_candidates_in_row(SparseSC_State &st, long a, BestMerge &at_min, BestMerge &at_max) {
+    double row_min = std::numeric_limits<double>::infinity();
+    SparseRow const &row = st.rows[a];
+    for (auto edge = find_edge(row, a + 1); edge != row.end(); ++edge) {
+        double dist_min = edge->f.at(st.alpha_min);
+        double dist_max = edge->f.at(st.alpha_max);
+        if (at_min.improves(dist_min, edge->f.slope(), a, edge->cluster)) {
+            at_min.lf = edge->f.function();
+            at_min.indices = MergeCandidate(a, edge->cluster);
+            at_min.dist = dist_min;
+        }
+        if (at_max.improves(dist_max, edge->f.slope(), a, edge->cluster)) {
+            at_max.lf = edge->f.function();
+            at_max.indices = MergeCandidate(a, edge->cluster);
+            at_max.dist = dist_max;
+        }
+        row_min = std::min(row_min, std::min(dist_min, dist_max));
+    }
+    st.row_bounds[a] = row_min;
+}
+
+/**
+ * Get the clusters and the resulting distance functions that get merged at both ends of the state's interval among
+ * the known distances. Like the dense scan, the row with the smallest bound is scanned first and rows whose bound is
+ * above both candidates are skipped.
+ * @param st - current state, the bounds of all scanned rows are tightened
+ * @return the next linear function distance(alpha) and the next merge clusters i and j for alpha_min and alpha_max,
+ * both clusters are std::numeric_limits<long>::max() if no distance between active clusters is known
+ */
+inline std::pair<std::pair<LinearFunction, MergeCandidate>, std::pair<LinearFunction, MergeCandidate> >
+find_merge_candidates(SparseSC_State &st) {
+    BestMerge at_min, at_max;
+    std::vector<long> const &active_indices = st.active_indices;
+    size_t seed = 0;
+    for (size_t i = 1; i < active_indices.size(); i++) {
+        if (st.row_bounds[active_indices[i]] < st.row_bounds[active_indices[seed]]) {
+            seed = i;
+        }
+    }
+    if (!active_indices.empty()) {
+        find_merge_candidates_in_row(st, active_indices[seed], at_min, at_max);
+    }
+    for (size_t i = 0; i < active_indices.size(); i++) {
+        double bound = st.row_bounds[active_indices[i]];
+        if (i != seed && (bound <= at_min.dist || bound <= at_max.dist)) {
+            find_merge_candidates_in_row(st, active_indices[i], at_min, at_max);
+        }
+    }
+    return {{at_min.lf, at_min.indices}, {at_max.lf, at_max.indices}};
+}
+
+/**
+ * Calculates the nearest intersection of a given linear function with the known distances, visited in the same order
+ * as the dense scan, i.e. by the first and then by the second cluster.
+ * @param st - current state
+ * @param lf_in - the input linear function distance(alpha) which is used to calculate the next intersection
+ * @param alpha_start - the current value of alpha
+ * @param alpha_end - the maximum value of alpha in the given interval
+ * @return the nearest intersection, alpha_end if there is none
+ */
+inline Intersection calculate_nearest_intersection(SparseSC_State const &st, LinearFunction lf_in,
+                                                   double alpha_start, double alpha_end) {
+    LinearFunction lf_opt(0.0, 0.0);
+    auto alpha_min = alpha_end;
+    MergeCandidate indices;
+    double lf_in_max = std::max(lf_in.b + alpha_start * lf_in.a, lf_in.b + alpha_end * lf_in.a);
+    double limit = lf_in_max + Clustering::intersection_bound_margin * std::max(1.0, std::abs(lf_in_max));
+    for (long a : st.active_indices) {
+        if (st.row_bounds[a] > limit) {
+            continue;
+        }
+        SparseRow const &row = st.rows[a];
+        for (auto edge = find_edge(row, a + 1); edge != row.end(); ++edge) {
+            LinearFunction lf_out = edge->f.function();
+            double intersection = lf_in.calculate_interaction_with(lf_out);
+            if (intersection < alpha_min && intersection > alpha_start) {
+                indices = MergeCandidate(a, edge->cluster);
+                alpha_min = intersection;
+                lf_opt = lf_out;
+            }
+        }
+    }
+    return {alpha_min, lf_opt, indices};
+}
+
+/**
+ * Makes all distances between the active clusters known, which is needed once the neighbour graph falls apart into
+ * several components that got merged completely. The distances are computed from all point pairs of both clusters, so
+ * k should be large enough that only few components are left.
+ * @param st - current state without any known distance between active clusters
+ */
+inline void connect_clusters(SparseSC_State &st) {
+    std::vector<long> const &active_indices = st.active_indices;
+    std::vector<std::vector<double> > const &points = *st.points;
+    for (size_t i = 0; i < active_indices.size(); i++) {
+        long a = active_indices[i];
+        double row_min = std::numeric_limits<double>::infinity();
+        for (size_t j = i + 1; j < active_indices.size(); j++) {
+            long b = active_indices[j];
+            double low = std::numeric_limits<double>::infinity();
+            double up = 0.0;
+            for (long p : st.members[a]) {
+                for (long q : st.members[b]) {
+                    double dist = DistanceFunction::euclidean_dist(points[p], points[q]);
+                    low = std::min(low, dist);
+                    up = std::max(up, dist);
+                }
+            }
+            long known = (long) (st.members[a].size() * st.members[b].size());
+            st.rows[a].emplace_back(b, InterpolatedDistance(low, up), known);
+            st.rows[b].emplace_back(a, InterpolatedDistance(low, up), known);
+            row_min = std::min(row_min, InterpolatedDistance(low, up).at(st.alpha_min));
+        }
+        st.row_bounds[a] = row_min;
+    }
+    for (long a : active_indices) {
+        std::sort(st.rows[a].begin(), st.rows[a].end(), [](SparseEdge const &e1, SparseEdge const &e2) {
+            return e1.cluster < e2.cluster;
+        });
+    }
+    st.edges = (long) (active_indices.size() * (active_indices.size() - 1) / 2);
+}
+
+/**
+ * Calculates all children nodes for a sparse parent node, see Clustering::getsplitstates.
+ * @param st - the parent state
+ * @param states - receives the children states
+ * @param threads - unused, sparse states are scanned serially
+ */
+inline void getsplitstates(SparseSC_State &st, std::vector<SplitState> &states, size_t threads = 1) {
+    auto candidates = find_merge_candidates(st);
+    if (std::get<1>(candidates.first).cluster1 == std::numeric_limits<long>::max()) {
+        connect_clusters(st);
+        candidates = find_merge_candidates(st);
+    }
+    std::pair<LinearFunction, MergeCandidate> lower = candidates.first;
+    std::pair<LinearFunction, MergeCandidate> upper = candidates.second;
+    if (std::get<1>(lower).cluster1 != std::get<1>(upper).cluster1 ||
+        std::get<1>(lower).cluster2 != std::get<1>(upper).cluster2) {
+        auto alpha = st.alpha_min;
+        while (alpha < st.alpha_max) {
+            Intersection is = calculate_nearest_intersection(st, std::get<0>(lower), alpha, st.alpha_max);
+            states.emplace_back(std::get<1>(lower), alpha, is.alpha);
+            lower = std::pair<LinearFunction, MergeCandidate>(is.next_function, is.next_merge);
+            alpha = is.alpha;
+        }
+    } else {
+        states.emplace_back(std::get<1>(lower), st.alpha_min, st.alpha_max);
+    }
+}
+
+/**
+ * Finds all pairs of clusters that are each other's unique nearest neighbour among the known distances at both ends
+ * of the state's interval, see find_certified_merges for dense states.
+ * @param st - current state
+ * @param threads - unused, sparse states are scanned serially
+ * @return the certified merges, ordered by their first cluster
+ */
+inline std::vector<MergeCandidate> find_certified_merges(SparseSC_State const &st, size_t threads = 1) {
+    std::vector<NearestNeighbour> at_min(st.rows.size()), at_max(st.rows.size());
+    for (long a : st.active_indices) {
+        SparseRow const &row = st.rows[a];
+        for (auto edge = find_edge(row, a + 1); edge != row.end(); ++edge) {
+            double dist_min = edge->f.at(st.alpha_min);
+            double dist_max = edge->f.at(st.alpha_max);
+            at_min[a].offer(dist_min, (size_t) edge->cluster);
+            at_min[edge->cluster].offer(dist_min, (size_t) a);
+            at_max[a].offer(dist_max, (size_t) edge->cluster);
+            at_max[edge->cluster].offer(dist_max, (size_t) a);
+        }
+    }
+    std::vector<MergeCandidate> merges;
+    for (long a : st.active_indices) {
+        auto b = (long) at_min[a].position;
+        if (b > a && at_min[a].unique && at_min[b].unique && at_min[b].position == (size_t) a && at_max[a].unique &&
+            at_max[b].unique && at_max[a].position == (size_t) b && at_max[b].position == (size_t) a) {
+            merges.emplace_back(a, b);
+        }
+    }
+    return merges;
+}
+
+/**
+ * Calculates the distance between the anchors, i.e. the first points, of two clusters. Together with the reaches of
+ * both clusters it bounds the distance of every point pair of them from both sides.
+ * @param st - current state
+ * @param c - first cluster
+ * @param x - second cluster
+ * @return the distance between both anchors
+ */
+inline double anchor_dist(SparseSC_State const &st, long c, long x) {
+    return DistanceFunction::euclidean_dist((*st.points)[st.members[c][0]], (*st.points)[st.members[x][0]]);
+}
+
+/**
+ * Checks whether merging clusters i and j is also right for the exact linkage on the whole interval of the state. This
+ * holds if all distances are known, or if i and j are each other's unique nearest neighbour even when their distance
+ * takes its largest possible value and every other distance of them its smallest possible value. A distance that
+ * misses point pairs is bounded from below by the larger radius of both clusters (every missing pair is at least that
+ * far apart) and from both sides by the anchors and reaches of both clusters. An unknown distance is at least the
+ * radius of the cluster. The linkage is reducible, so mutual nearest neighbours get merged in the exact run as well.
+ * @param st - current state
+ * @param i - first merged cluster
+ * @param j - second merged cluster
+ * @return true if the merge is certain
+ */
+inline bool is_certain_merge(SparseSC_State const &st, long i, long j) {
+    auto m = (long) st.active_indices.size();
+    if (st.incomplete == 0 && st.edges == m * (m - 1) / 2) {
+        return true;
+    }
+    auto ij = find_edge(st.rows[i], j);
+    if (ij == st.rows[i].end() || ij->cluster != j) {
+        return false;
+    }
+    // the exact single linkage distance is at most the known one, the exact complete linkage distance at most the
+    // distance of the anchors plus both reaches
+    InterpolatedDistance largest = ij->f;
+    if (!is_complete(st, i, *ij)) {
+        largest.upper = anchor_dist(st, i, j) + st.reach[i] + st.reach[j];
+    }
+    double at_min = largest.at(st.alpha_min);
+    double at_max = largest.at(st.alpha_max);
+    for (long c : {i, j}) {
+        SparseRow const &row = st.rows[c];
+        if ((long) row.size() < m - 1 && (st.radii[c] <= at_min || st.radii[c] <= at_max)) {
+            return false;
+        }
+        for (SparseEdge const &edge : row) {
+            if (edge.cluster == i || edge.cluster == j) {
+                continue;
+            }
+            InterpolatedDistance smallest = edge.f;
+            if (!is_complete(st, c, edge)) {
+                double far = std::max(st.radii[c], st.radii[edge.cluster]);
+                double low = std::max(std::min(edge.f.lower, far),
+                                      anchor_dist(st, c, edge.cluster) - st.reach[c] - st.reach[edge.cluster]);
+                smallest = InterpolatedDistance(low, std::max(edge.f.upper, far));
+            }
+            if (smallest.at(st.alpha_min) <= at_min || smallest.at(st.alpha_max) <= at_max) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Merge clusters i and j of a sparse state when interpolating between single and complete linkage. The known
+ * distances of both rows are combined, a distance known to only one of them is kept as is. Every other row gets its
+ * distance to j replaced by the new distance to i. The bounds are maintained as in merge_dists.
+ * @param st - current state
+ * @param i - first merged cluster
+ * @param j - second merged cluster
+ * @param threads - unused, sparse states are updated serially
+ */
+inline void merge_clusters(SparseSC_State &st, long i, long j, size_t threads = 1) {
+    if (st.exact && !is_certain_merge(st, i, j)) {
+        st.exact = false;
+    }
+    SparseRow const &row_i = st.rows[i];
+    SparseRow const &row_j = st.rows[j];
+    long old_edges = (long) (row_i.size() + row_j.size());
+    long old_incomplete = 0;
+    for (SparseEdge const &edge : row_i) {
+        old_incomplete += is_complete(st, i, edge) ? 0 : 1;
+        old_edges -= edge.cluster == j ? 1 : 0;
+    }
+    for (SparseEdge const &edge : row_j) {
+        old_incomplete += edge.cluster == i || is_complete(st, j, edge) ? 0 : 1;
+    }
+
+    // combine both rows, which are ordered by the other cluster
+    SparseRow merged;
+    merged.reserve(row_i.size() + row_j.size());
+    auto ei = row_i.begin(), ej = row_j.begin();
+    while (ei != row_i.end() || ej != row_j.end()) {
+        if (ej == row_j.end() || (ei != row_i.end() && ei->cluster < ej->cluster)) {
+            merged.push_back(*ei++);
+        } else if (ei == row_i.end() || ej->cluster < ei->cluster) {
+            merged.push_back(*ej++);
+        } else {
+            InterpolatedDistance f(std::min(ei->f.lower, ej->f.lower), std::max(ei->f.upper, ej->f.upper));
+            merged.emplace_back(ei->cluster, f, ei->known + ej->known);
+            ++ei;
+            ++ej;
+        }
+        if (!merged.empty() && (merged.back().cluster == i || merged.back().cluster == j)) {
+            merged.pop_back();
+        }
+    }
+
+    // the smaller list of points is appended to the larger one, whose anchor and reach are kept and widened
+    if (st.members[i].size() < st.members[j].size()) {
+        std::swap(st.members[i], st.members[j]);
+        std::swap(st.reach[i], st.reach[j]);
+    }
+    std::vector<double> const &anchor = (*st.points)[st.members[i][0]];
+    for (long q : st.members[j]) {
+        st.reach[i] = std::max(st.reach[i], DistanceFunction::euclidean_dist(anchor, (*st.points)[q]));
+    }
+    st.members[i].insert(st.members[i].end(), st.members[j].begin(), st.members[j].end());
+    st.members[j] = std::vector<long>();
+    st.radii[i] = std::min(st.radii[i], st.radii[j]);
+
+    long new_incomplete = 0;
+    double row_i_min = std::numeric_limits<double>::infinity();
+    for (SparseEdge const &edge : merged) {
+        SparseRow &row_x = st.rows[edge.cluster];
+        auto to_j = find_edge(row_x, j);
+        if (to_j != row_x.end() && to_j->cluster == j) {
+            row_x.erase(to_j);
+        }
+        auto to_i = find_edge(row_x, i);
+        if (to_i != row_x.end() && to_i->cluster == i) {
+            to_i->f = edge.f;
+            to_i->known = edge.known;
+        } else {
+            row_x.insert(to_i, SparseEdge(i, edge.f, edge.known));
+        }
+        double bound = std::min(edge.f.at(st.alpha_min), edge.f.at(st.alpha_max));
+        if (edge.cluster > i) {
+            row_i_min = std::min(row_i_min, bound);
+        } else {
+            st.row_bounds[edge.cluster] = std::min(st.row_bounds[edge.cluster], bound);
+        }
+        new_incomplete += is_complete(st, i, edge) ? 0 : 1;
+    }
+    st.edges += (long) merged.size() - old_edges;
+    st.incomplete += new_incomplete - old_incomplete;
+    st.rows[i] = std::move(merged);
+    st.rows[j] = SparseRow();
+    st.row_bounds[i] = row_i_min;
+    st.active_indices.erase(std::remove(st.active_indices.begin(), st.active_indices.end(), j),
+                            st.active_indices.end());
+    st.nodes[i] = new ClusterNode(st.nodes[i], st.nodes[j]);
+}
+
+/**
+ * Checks whether the clustering of a sparse state is certainly the one of the exact linkage.
+ * @param st - current state
+ * @return true if no merge of the state could have been changed by the unknown distances
+ */
+inline bool is_exact(SparseSC_State const &st) {
+    return st.exact;
+}
+
+#endif /* SparseLinkage_h */
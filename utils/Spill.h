@@ -0,0 +1,194 @@
+#ifndef Spill_h
+#define Spill_h
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "LinkageOptions.h"
+#include "SparseState.h"
+#include "State.h"
+
+namespace Spill {
+
+    /**
+     * Gets the scratch file of a spilled state, which is unique per process.
+     * @param options - the scratch directory
+     * @param id - the number of the spilled state
+     * @return the path of the scratch file
+     */
+    inline std::string file(LinkageOptions const &options, long id) {
+        return options.scratch_dir + "/alphalinkage_" + std::to_string((long) getpid()) + "_" + std::to_string(id) +
+               ".spill";
+    }
+
+    /**
+     * Estimates the bytes that a state holds.
+     * @param st - the state
+     * @return the bytes of its distances and index vectors
+     */
+    inline size_t bytes(State const &st) {
+        return st.dists.capacity() * sizeof(InterpolatedDistance) + st.row_bounds.capacity() * sizeof(double) +
+               st.active_indices.capacity() * sizeof(long) + st.nodes.capacity() * sizeof(ClusterNode *);
+    }
+
+    /**
+     * Estimates the bytes that a sparse state holds.
+     * @param st - the state
+     * @return the bytes of its rows and index vectors
+     */
+    inline size_t bytes(SparseSC_State const &st) {
+        size_t sum = st.active_indices.capacity() * sizeof(long) + st.nodes.capacity() * sizeof(ClusterNode *);
+        for (SparseRow const &row : st.rows) {
+            sum += row.capacity() * sizeof(SparseEdge);
+        }
+        for (std::vector<long> const &members : st.members) {
+            sum += members.capacity() * sizeof(long);
+        }
+        return sum;
+    }
+
+    /**
+     * Writes the distances between the active clusters of a state. Only active pairs are written, so the file shrinks
+     * with every merge of the state.
+     * @param st - the state
+     * @param out - output stream
+     */
+    inline void save(State const &st, std::ostream &out) {
+        for (size_t a = 0; a < st.active_indices.size(); a++) {
+            long row = st.layout.row_base(st.active_indices[a]);
+            for (size_t b = a + 1; b < st.active_indices.size(); b++) {
+                InterpolatedDistance const &f = st.dists[row + st.active_indices[b]];
+                out.write(reinterpret_cast<const char *>(&f), sizeof(InterpolatedDistance));
+            }
+        }
+    }
+
+    /**
+     * Writes the distances between the active clusters of a state and releases all distances if they were written.
+     * @param st - the state
+     * @param out - output stream
+     */
+    inline void write(State &st, std::ostream &out) {
+        save(st, out);
+        if (out.flush()) {
+            DistanceFunctions().swap(st.dists);
+        }
+    }
+
+    /**
+     * Reads the distances that were written by save into the layout of the state. Pairs of merged clusters are never
+     * read again and stay zero.
+     * @param st - the state
+     * @param in - input stream
+     */
+    inline void read(State &st, std::istream &in) {
+        st.dists.assign(st.layout.entries(), InterpolatedDistance(0.0, 0.0));
+        for (size_t a = 0; a < st.active_indices.size(); a++) {
+            long i = st.active_indices[a];
+            long row = st.layout.row_base(i);
+            for (size_t b = a + 1; b < st.active_indices.size(); b++) {
+                long j = st.active_indices[b];
+                in.read(reinterpret_cast<char *>(&st.dists[row + j]), sizeof(InterpolatedDistance));
+                if (st.layout.is_square()) {
+                    st.dists[j * st.layout.stride + i] = st.dists[row + j];
+                }
+            }
+        }
+    }
+
+    /**
+     * Writes the rows of the active clusters of a sparse state.
+     * @param st - the state
+     * @param out - output stream
+     */
+    inline void save(SparseSC_State const &st, std::ostream &out) {
+        for (long i : st.active_indices) {
+            size_t size = st.rows[i].size();
+            out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+            out.write(reinterpret_cast<const char *>(st.rows[i].data()), size * sizeof(SparseEdge));
+        }
+    }
+
+    /**
+     * Writes the rows of the active clusters of a sparse state and releases all rows if they were written.
+     * @param st - the state
+     * @param out - output stream
+     */
+    inline void write(SparseSC_State &st, std::ostream &out) {
+        save(st, out);
+        if (out.flush()) {
+            std::vector<SparseRow>(st.rows.size()).swap(st.rows);
+        }
+    }
+
+    /**
+     * Reads the rows that were written by save.
+     * @param st - the state
+     * @param in - input stream
+     */
+    inline void read(SparseSC_State &st, std::istream &in) {
+        for (long i : st.active_indices) {
+            size_t size = 0;
+            in.read(reinterpret_cast<char *>(&size), sizeof(size));
+            st.rows[i].assign(size, SparseEdge(0, InterpolatedDistance(0.0, 0.0), 0));
+            in.read(reinterpret_cast<char *>(st.rows[i].data()), size * sizeof(SparseEdge));
+        }
+    }
+
+    /**
+     * Loads a spilled state back into memory and deletes its scratch file.
+     * @param st - the spilled state
+     * @param options - the scratch directory
+     */
+    template<typename S>
+    void restore(S &st, LinkageOptions const &options) {
+        std::string path = file(options, st.spilled);
+        std::ifstream in(path, std::ios::binary);
+        read(st, in);
+        if (!in) {
+            std::cerr << "Error: the spilled state " << path << " cannot be read." << std::endl;
+        }
+        in.close();
+        std::remove(path.c_str());
+        st.spilled = -1;
+    }
+
+    /**
+     * Keeps the bytes of the pending states within options.memory_limit. If they exceed it, the states that will be
+     * processed last (i.e. the coldest, at the end of the depth first order) are written to the scratch directory until
+     * the states in memory fit again. The first state, which is processed next, always stays in memory.
+     * @param states - the pending states of the tree of executions in the order of processing
+     * @param options - the memory limit and scratch directory
+     * @param next_id - the number of the next spilled state, is increased for every spilled state
+     */
+    template<typename S>
+    void limit(std::vector<S> &states, LinkageOptions const &options, long &next_id) {
+        size_t total = 0;
+        for (S const &st : states) {
+            total += bytes(st);
+        }
+        for (size_t index = states.size(); index-- > 1 && total > options.memory_limit;) {
+            if (states[index].spilled >= 0) {
+                continue;
+            }
+            std::string path = file(options, next_id);
+            std::ofstream out(path, std::ios::binary);
+            size_t before = bytes(states[index]);
+            write(states[index], out);
+            out.close();
+            if (!out) {
+                std::cerr << "Warning: states cannot be spilled to " << path << "." << std::endl;
+                std::remove(path.c_str());
+                return;
+            }
+            total = total - before + bytes(states[index]);
+            states[index].spilled = next_id++;
+        }
+    }
+}
+
+#endif /* Spill_h */